@@ -0,0 +1,774 @@
+// CPU transpose benchmark
+//
+// Runs the CPU versions of the kernels of transpose.cu (see
+// transpose_cpu.h) and reports the bandwidth with the same formula,
+// so the CPU and GPU numbers can be compared directly. The shape,
+// element type and number of repetitions are given on the command
+// line; with -s, the sizes are swept from 4 KB (L1 resident) up to
+// a given size, to show the bandwidth of each level of the memory
+// hierarchy. A shape is followed by the batched transpose of small
+// matrices, reported in matrices per second. Each call is timed, and
+// the bandwidth is the median over the calls (see transpose_report.h).
+// With -f, a raw file is transposed out of core instead (see
+// transpose_ooc.h).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <stdint.h>
+#include <complex>
+#include <algorithm>
+#include <omp.h>
+
+#include "transpose_cpu.h"
+#include "transpose_tune.h"
+#include "transpose_report.h"
+#include "transpose_ooc.h"
+
+const int NUM_REPS = 100;
+const int NUM_WARMUP = 1;
+
+// Untimed calls before the timed calls of a routine, set with -w
+int warmup = NUM_WARMUP;
+
+// Highest instruction set of the micro-kernels, lowered with -i
+simd_isa max_isa = ISA_AVX512;
+
+// With -I, allocate one matrix and run only the in-place routines
+bool inplace_only = false;
+
+// With -a, tune the blocked transpose before timing it; the results
+// go to tune_file, keyed by cpu_model
+bool        tune = false;
+const char *tune_file = NULL;
+char        cpu_model[256];
+
+// Smallest matrix of the sweep, and bytes moved per size of the sweep
+const size_t SWEEP_MIN_BYTES = 4096;
+const double SWEEP_BYTES_PER_SIZE = 4e9;
+
+// Sizes of the batched transpose, bytes of a batch, and time limit
+// of the repetitions of a size
+const int BATCH_SIZES[] = { 8, 16, 32, 64 };
+const int NUM_BATCH_SIZES = sizeof(BATCH_SIZES) / sizeof(BATCH_SIZES[0]);
+const size_t BATCH_BYTES = 16 << 20;
+const double BATCH_SECONDS = 1.0;
+
+// With -b, the number of matrices of a batch; 0 fills BATCH_BYTES
+int batch_count = 0;
+
+// With -f and -F, the files of the out-of-core transpose, and with
+// -m, the RAM budget of its buffers
+const char *ooc_in = NULL, *ooc_out = NULL;
+size_t      ooc_budget = OOC_BUDGET;
+
+struct routine {
+  const char *name;
+  const char *label;          // column heading of the sweep
+  bool        transposes;
+  bool        inplace;        // odata is also the input
+};
+
+const routine routines[] = {
+  { "copy",                    "copy",      false, false },
+  { "shared memory copy",      "smem copy", false, false },
+  { "naive transpose",         "naive",     true,  false },
+  { "coalesced transpose",     "coalesced", true,  false },
+  { "conflict-free transpose", "no-bank",   true,  false },
+  { "SIMD transpose",          "simd",      true,  false },
+  { "recursive transpose",     "recursive", true,  false },
+  { "in-place transpose",      "in-place",  true,  true  },
+  { "tuned transpose",         "tuned",     true,  false }
+};
+const int NUM_ROUTINES = sizeof(routines) / sizeof(routines[0]);
+
+// Micro-kernel for element type T, selected on first use
+template <typename T>
+const microKernel<T> &micro()
+{
+  static const microKernel<T> mk = selectMicroKernel<T>(max_isa);
+  return mk;
+}
+
+// 16-bit floating point formats: the transpose only moves their
+// bits, so they are stored as such
+struct fp16 { uint16_t bits; };
+struct bf16 { uint16_t bits; };
+
+inline bool operator==(fp16 a, fp16 b) { return a.bits == b.bits; }
+inline bool operator==(bf16 a, bf16 b) { return a.bits == b.bits; }
+
+typedef std::complex<double> complex_t;
+
+// Name of element type T, as given to -t
+template <typename T> const char *typeName();
+template <> const char *typeName<float>()     { return "float"; }
+template <> const char *typeName<double>()    { return "double"; }
+template <> const char *typeName<complex_t>() { return "complex"; }
+template <> const char *typeName<int8_t>()    { return "int8"; }
+template <> const char *typeName<fp16>()      { return "fp16"; }
+template <> const char *typeName<bf16>()      { return "bf16"; }
+
+// Parameters of the tuned transpose for element type T
+template <typename T>
+tuneParams &tuned()
+{
+  static tuneParams p;
+  return p;
+}
+
+// The kernels of routines[] for element type T; false if the kernel
+// failed, which only the in-place transpose can, out of memory for
+// its bit-vectors
+template <typename T>
+bool kernel(int r, T *odata, const T *idata, int nx, int ny)
+{
+  switch (r) {
+  case 0: copy(odata, idata, nx, ny); break;
+  case 1: copySharedMem(odata, idata, nx, ny); break;
+  case 2: transposeNaive(odata, idata, nx, ny); break;
+  case 3: transposeCoalesced(odata, idata, nx, ny); break;
+  case 4: transposeNoBankConflicts(odata, idata, nx, ny); break;
+  case 5: transposeSimd(odata, idata, nx, ny, micro<T>()); break;
+  case 6: transposeRecursive(odata, idata, nx, ny, micro<T>()); break;
+  case 7: return transposeInPlace(odata, nx, ny);
+  case 8: transposeTuned(odata, idata, nx, ny, tuned<T>()); break;
+  }
+  return true;
+}
+
+// Element i of the input matrix; the narrow types fold the high
+// bits of i in, so that a misplaced element is unlikely to match
+template <typename T>
+inline T element(size_t i)
+{
+  return (T) i;
+}
+
+template <>
+inline complex_t element<complex_t>(size_t i)
+{
+  return complex_t((double) i, -(double) i);
+}
+
+template <>
+inline int8_t element<int8_t>(size_t i)
+{
+  return (int8_t) (i ^ i >> 8 ^ i >> 16 ^ i >> 24);
+}
+
+template <>
+inline fp16 element<fp16>(size_t i)
+{
+  fp16 e = { (uint16_t) (i ^ i >> 16) };
+  return e;
+}
+
+template <>
+inline bf16 element<bf16>(size_t i)
+{
+  bf16 e = { (uint16_t) (i ^ i >> 16) };
+  return e;
+}
+
+// Fill a ny x nx matrix with the input, touching the pages from the
+// threads that will use them
+template <typename T>
+void fill(T *data, int nx, int ny)
+{
+  #pragma omp parallel for schedule(static)
+  for (int j = 0; j < ny; j++)
+    for (int i = 0; i < nx; i++)
+      data[(size_t) j*nx + i] = element<T>((size_t) j*nx + i);
+}
+
+// Check the result against the input, or its transpose
+template <typename T>
+bool check(const T *res, int nx, int ny, bool transposed)
+{
+  for (int y = 0; y < ny; y++)
+    for (int x = 0; x < nx; x++) {
+      size_t i = transposed ? (size_t) x*ny + y : (size_t) y*nx + x;
+      T ref = element<T>((size_t) y*nx + x);
+      if (!(res[i] == ref)) {
+        printf("%zu: element (%d, %d) misplaced\n", i, x, y);
+        return false;
+      }
+    }
+  return true;
+}
+
+// Array for the times of reps calls
+static double *alloc_times(int reps)
+{
+  double *sec = (double *) malloc(reps * sizeof(double));
+  if (sec == NULL)
+    printf("Could not allocate the times of %d calls\n", reps);
+  return sec;
+}
+
+// Time reps in-place calls of routine r on data after the warm-up
+// calls. Each call transposes the result of the previous one, so the
+// calls alternate between the ny x nx matrix and its nx x ny
+// transpose. False if a call failed or the result is wrong.
+template <typename T>
+bool run_inplace(int r, T *data, int nx, int ny, int reps, benchStats *st)
+{
+  double *sec = alloc_times(reps);
+  bool ok = true;
+  if (sec == NULL)
+    return false;
+
+  fill(data, nx, ny);
+  for (int i = -warmup; i < reps && ok; i++) {
+    double start = omp_get_wtime();
+    if ((i + warmup) % 2 == 0)
+      ok = kernel(r, data, data, nx, ny);
+    else
+      ok = kernel(r, data, data, ny, nx);
+    if (i >= 0)
+      sec[i] = omp_get_wtime() - start;
+  }
+  if (!ok) {
+    printf("Out of memory for the bit-vectors\n");
+    free(sec);
+    return false;
+  }
+  *st = benchSummary(sec, reps, 2.0 * nx * ny * sizeof(T));
+  free(sec);
+  return check(data, nx, ny, (warmup + reps) % 2 == 1);
+}
+
+// Time reps calls of routine r after the warm-up calls; false if the
+// result is wrong
+template <typename T>
+bool run(int r, T *odata, const T *idata, int nx, int ny, int reps, benchStats *st)
+{
+  if (routines[r].inplace)
+    return run_inplace(r, odata, nx, ny, reps, st);
+
+  double *sec = alloc_times(reps);
+  if (sec == NULL)
+    return false;
+
+  std::fill_n(odata, (size_t) nx * ny, T());
+  // warm up
+  for (int i = 0; i < warmup; i++)
+    kernel(r, odata, idata, nx, ny);
+  for (int i = 0; i < reps; i++) {
+    double start = omp_get_wtime();
+    kernel(r, odata, idata, nx, ny);
+    sec[i] = omp_get_wtime() - start;
+  }
+  *st = benchSummary(sec, reps, 2.0 * nx * ny * sizeof(T));
+  free(sec);
+  return check(odata, nx, ny, routines[r].transposes);
+}
+
+// Median of s as a percentage of that of copy, negative if copy did
+// not run
+static double pct_copy(const benchStats &s, double copy)
+{
+  return copy > 0 ? 100.0 * s.median / copy : -1;
+}
+
+// Allocate and fill a ny x nx matrix and its output; with idata
+// NULL, only the output is allocated, for the in-place routines
+template <typename T>
+bool alloc_matrices(T **idata, T **odata, int nx, int ny)
+{
+  size_t mem_size = (size_t) nx * ny * sizeof(T);
+  *odata = (T *) malloc(mem_size);
+  if (idata)
+    *idata = (T *) malloc(mem_size);
+  if (*odata == NULL || (idata && *idata == NULL)) {
+    printf("Could not allocate %d x %zu bytes\n", idata ? 2 : 1, mem_size);
+    if (idata)
+      free(*idata);
+    free(*odata);
+    return false;
+  }
+
+  fill(*odata, nx, ny);
+  if (idata)
+    fill(*idata, nx, ny);
+  return true;
+}
+
+// Peak resident set size of the process, in MB
+static double peak_rss_mb()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss / 1024.0;
+}
+
+// Set the parameters of the tuned transpose for a ny x nx matrix:
+// search them with -a and store them in the cache, else read them
+// from the cache, else use the defaults. Return where they come from.
+template <typename T>
+const char *set_tuning(T *odata, const T *idata, int nx, int ny, bool verbose)
+{
+  tuneParams &p = tuned<T>();
+  int max_threads = omp_get_max_threads();
+
+  if (tune) {
+    p = autotune(odata, idata, nx, ny, max_threads, max_isa, verbose);
+    if (!tuneStore(tune_file, cpu_model, typeName<T>(), nx, ny, max_threads, p))
+      printf("Could not write the tuning cache %s\n", tune_file);
+    return "tuned";
+  }
+  if (tuneLookup(tune_file, cpu_model, typeName<T>(), nx, ny, max_threads, max_isa, &p))
+    return "cached";
+  p = tuneDefaults(max_isa);
+  return "default";
+}
+
+// Transpose a batch of count n x n matrices: one transposeBatched
+// call, or with per_call one transposeSimd call per matrix, as a
+// loop of kernel launches would
+template <typename T>
+void kernel_batched(bool per_call, T *odata, const T *idata, int n, int count,
+                    const microKernel<T> &mk)
+{
+  size_t stride = (size_t) n * n;
+
+  if (!per_call) {
+    transposeBatched(odata, idata, n, n, count, stride, stride, mk);
+    return;
+  }
+  for (int b = 0; b < count; b++)
+    transposeSimd(odata + b*stride, idata + b*stride, n, n, micro<T>());
+}
+
+// Time up to reps batches after the warm-up batches, stopping after
+// BATCH_SECONDS; false if the result is wrong
+template <typename T>
+bool run_batched(bool per_call, T *odata, const T *idata, int n, int count, int reps,
+                 const microKernel<T> &mk, benchStats *st)
+{
+  size_t stride = (size_t) n * n;
+  double *sec = alloc_times(reps), total = 0;
+  int done = 0;
+
+  if (sec == NULL)
+    return false;
+
+  std::fill_n(odata, stride * count, T());
+  // warm up
+  for (int i = 0; i < warmup; i++)
+    kernel_batched(per_call, odata, idata, n, count, mk);
+  do {
+    double start = omp_get_wtime();
+    kernel_batched(per_call, odata, idata, n, count, mk);
+    total += sec[done++] = omp_get_wtime() - start;
+  } while (done < reps && total < BATCH_SECONDS);
+  *st = benchSummary(sec, done, 2.0 * stride * count * sizeof(T));
+  free(sec);
+
+  for (int b = 0; b < count; b++)
+    for (int y = 0; y < n; y++)
+      for (int x = 0; x < n; x++)
+        if (!(odata[b*stride + (size_t) x*n + y] == element<T>(b*stride + (size_t) y*n + x))) {
+          printf("matrix %d: element (%d, %d) misplaced\n", b, x, y);
+          return false;
+        }
+  return true;
+}
+
+// The batched transpose of the BATCH_SIZES square matrices, against
+// a transposeSimd call per matrix
+template <typename T>
+int bench_batched(int reps)
+{
+  if (batch_count)
+    printf("\nBatched transpose, %d matrices per batch", batch_count);
+  else
+    printf("\nBatched transpose, %zu MB per batch", BATCH_BYTES >> 20);
+  printf(", Element size: %zu\n", sizeof(T));
+  printf("%8s %10s %16s %16s %16s %7s %14s\n", "size", "matrices", "micro-kernel",
+         "per-call (GB/s)", "batched (GB/s)", "CV %", "matrices/s");
+
+  for (int s = 0; s < NUM_BATCH_SIZES; s++) {
+    int n = BATCH_SIZES[s];
+    size_t bytes = (size_t) n * n * sizeof(T);
+    int count = batch_count ? batch_count : (int) (BATCH_BYTES / bytes);
+    microKernel<T> mk = selectMicroKernel<T>(max_isa, n, n);
+
+    T *h_idata, *h_odata;
+    if (!alloc_matrices(&h_idata, &h_odata, n * n, count))
+      return 1;
+
+    printf("%8d %10d %8s %2d x %-2d", n, count, simd_isa_name[mk.isa], mk.dim, mk.dim);
+    fflush(stdout);
+    benchStats call, st;
+    bool call_ok = run_batched(true, h_odata, h_idata, n, count, reps, mk, &call);
+    if (call_ok) {
+      printf(" %16.2f", call.median);
+      reportWrite(typeName<T>(), "per-call transpose", n, n, count, call, -1);
+    } else
+      printf(" %16s", "FAILED");
+    fflush(stdout);
+    bool ok = run_batched(false, h_odata, h_idata, n, count, reps, mk, &st);
+    if (ok) {
+      printf(" %16.2f %7.1f %14.3g\n", st.median, st.cv * 100, st.median * 1e9 / (2.0 * bytes));
+      reportWrite(typeName<T>(), "batched transpose", n, n, count, st, -1);
+    } else
+      printf(" %16s\n", "FAILED");
+
+    free(h_idata);
+    free(h_odata);
+    if (!call_ok || !ok)
+      return 1;
+  }
+  return 0;
+}
+
+// One shape: the table of transpose.cu. The bandwidth of each
+// routine goes to gbps, -1 if it failed or did not run.
+template <typename T>
+int bench_one(int nx, int ny, int reps, double *gbps)
+{
+  T *h_idata = NULL, *h_odata;
+
+  printf("Matrix size: %d %d, Block size: %d %d, Tile size: %d %d\n",
+         nx, ny, TILE_DIM, BLOCK_ROWS, TILE_DIM, TILE_DIM);
+  printf("Tiles: %d %d, Element size: %zu, Repetitions: %d, Warm-up: %d\n",
+         numTiles(nx), numTiles(ny), sizeof(T), reps, warmup);
+  printf("Micro-kernel: %s %d x %d\n",
+         simd_isa_name[micro<T>().isa], micro<T>().dim, micro<T>().dim);
+
+  if (!alloc_matrices(inplace_only ? NULL : &h_idata, &h_odata, nx, ny))
+    return 1;
+
+  if (!inplace_only) {
+    const char *from = set_tuning(h_odata, h_idata, nx, ny, true);
+    const tuneParams &p = tuned<T>();
+    microKernel<T> mk = selectMicroKernel<T>(p.isa);
+    printf("Tuning (%s, %s): tile %d, micro-kernel %s %d x %d, %d threads\n",
+           from, tune_file, p.tile, simd_isa_name[mk.isa], mk.dim, mk.dim, p.threads);
+  }
+
+  printf("%25s%25s%9s%9s%8s%11s\n", "Routine", "Bandwidth (GB/s)", "p5", "p95", "CV %", "% of copy");
+  double copy_gbps = -1;
+  for (int r = 0; r < NUM_ROUTINES; r++) {
+    gbps[r] = -1;
+    if (inplace_only && !routines[r].inplace)
+      continue;
+    printf("%25s", routines[r].name);
+    fflush(stdout);
+    benchStats st;
+    if (!run(r, h_odata, h_idata, nx, ny, reps, &st)) {
+      printf("%25s\n", "*** FAILED ***");
+      continue;
+    }
+    gbps[r] = st.median;
+    if (r == 0)
+      copy_gbps = st.median;
+    double pct = pct_copy(st, copy_gbps);
+    printf("%20.2f%14.2f%9.2f%8.1f", st.median, st.p5, st.p95, st.cv * 100);
+    if (pct < 0)
+      printf("%11s\n", "-");
+    else
+      printf("%11.1f\n", pct);
+    reportWrite(typeName<T>(), routines[r].name, nx, ny, 1, st, pct);
+  }
+  printf("Peak RSS: %.1f MB\n", peak_rss_mb());
+
+  free(h_idata);
+  free(h_odata);
+  if (inplace_only)
+    return 0;
+  return bench_batched<T>(reps);
+}
+
+// Sweep the sizes from SWEEP_MIN_BYTES to max_bytes, doubling the
+// size at each step; the shape alternates between square and 2:1
+template <typename T>
+int bench_sweep(size_t max_bytes, int reps)
+{
+  printf("Sweep: %zu to %zu bytes, Tile size: %d %d, Element size: %zu\n",
+         SWEEP_MIN_BYTES, max_bytes, TILE_DIM, TILE_DIM, sizeof(T));
+  printf("Micro-kernel: %s %d x %d\n",
+         simd_isa_name[micro<T>().isa], micro<T>().dim, micro<T>().dim);
+  printf("%8s %8s %12s %5s", "nx", "ny", "bytes", "reps");
+  for (int r = 0; r < NUM_ROUTINES; r++)
+    printf(" %10s", routines[r].label);
+  printf("   (median GB/s)\n");
+
+  for (size_t bytes = SWEEP_MIN_BYTES; bytes <= max_bytes; bytes *= 2) {
+    size_t n = bytes / sizeof(T);
+    int nx = 1;
+    while ((size_t) nx * nx < n)
+      nx *= 2;
+    int ny = (int) (n / nx);
+
+    // move about SWEEP_BYTES_PER_SIZE bytes per size, but at most reps times
+    int size_reps = (int) (SWEEP_BYTES_PER_SIZE / (2.0 * bytes));
+    if (size_reps > reps) size_reps = reps;
+    if (size_reps < 1) size_reps = 1;
+
+    T *h_idata, *h_odata;
+    if (!alloc_matrices(&h_idata, &h_odata, nx, ny))
+      return 1;
+    set_tuning(h_odata, h_idata, nx, ny, false);
+
+    printf("%8d %8d %12zu %5d", nx, ny, bytes, size_reps);
+    fflush(stdout);
+    double copy_gbps = -1;
+    for (int r = 0; r < NUM_ROUTINES; r++) {
+      benchStats st;
+      if (run(r, h_odata, h_idata, nx, ny, size_reps, &st)) {
+        if (r == 0)
+          copy_gbps = st.median;
+        printf(" %10.2f", st.median);
+        reportWrite(typeName<T>(), routines[r].name, nx, ny, 1, st, pct_copy(st, copy_gbps));
+      } else
+        printf(" %10s", "FAILED");
+      fflush(stdout);
+    }
+    printf("\n");
+
+    free(h_idata);
+    free(h_odata);
+  }
+  return 0;
+}
+
+// Out-of-core transpose of the ny x nx matrix in ooc_in to ooc_out
+template <typename T>
+int bench_file(int nx, int ny)
+{
+  double bytes = (double) nx * ny * sizeof(T);
+  oocStats st;
+
+  printf("Out-of-core transpose: %s to %s\n", ooc_in, ooc_out);
+  printf("Matrix size: %d %d, Element size: %zu, Budget: %zu MB\n",
+         nx, ny, sizeof(T), ooc_budget >> 20);
+  printf("Micro-kernel: %s %d x %d\n",
+         simd_isa_name[micro<T>().isa], micro<T>().dim, micro<T>().dim);
+  fflush(stdout);
+
+  if (!transposeFile(ooc_in, ooc_out, nx, ny, ooc_budget, micro<T>(), &st))
+    return 1;
+
+  printf("Block: %d rows of %d columns, %d blocks, Buffers: 4 x %.1f MB\n",
+         st.h, st.w, st.blocks, (double) st.w * st.h * sizeof(T) / (1 << 20));
+  printf("Time: %.2f s, Bandwidth (read + write): %.2f GB/s\n",
+         st.seconds, 2 * bytes * 1e-9 / st.seconds);
+  printf("I/O thread busy: %.2f s, Transpose: %.2f s, %s bound\n",
+         st.io_seconds, st.transpose_seconds,
+         st.io_seconds >= st.transpose_seconds ? "I/O" : "compute");
+  printf("Peak RSS: %.1f MB\n", peak_rss_mb());
+
+  benchStats s = benchSummary(&st.seconds, 1, 2 * bytes);
+  reportWrite(typeName<T>(), "out-of-core transpose", nx, ny, 1, s, -1);
+  return 0;
+}
+
+// One shape, a sweep or a file of element type T
+template <typename T>
+int bench(int nx, int ny, int reps, size_t sweep_max, double *gbps)
+{
+  if (ooc_in)
+    return bench_file<T>(nx, ny);
+  if (sweep_max)
+    return bench_sweep<T>(sweep_max, reps);
+  return bench_one<T>(nx, ny, reps, gbps);
+}
+
+struct element_type {
+  const char *name;
+  int       (*bench)(int nx, int ny, int reps, size_t sweep_max, double *gbps);
+};
+
+const element_type types[] = {
+  { "float",   bench<float>     },
+  { "double",  bench<double>    },
+  { "complex", bench<complex_t> },
+  { "int8",    bench<int8_t>    },
+  { "fp16",    bench<fp16>      },
+  { "bf16",    bench<bf16>      }
+};
+const int NUM_TYPES = sizeof(types) / sizeof(types[0]);
+
+// Model name of the CPU, from /proc/cpuinfo
+static void cpu_name(char *name, int len)
+{
+  char line[256];
+  FILE *fp = fopen("/proc/cpuinfo", "r");
+
+  snprintf(name, len, "unknown CPU");
+  if (fp == NULL)
+    return;
+  while (fgets(line, sizeof(line), fp))
+    if (strncmp(line, "model name", 10) == 0) {
+      char *p = strchr(line, ':');
+      if (p) {
+        p += 2;
+        p[strcspn(p, "\n")] = '\0';
+        snprintf(name, len, "%s", p);
+      }
+      break;
+    }
+  fclose(fp);
+}
+
+// Parse a size in bytes with an optional K, M or G suffix
+static size_t parse_bytes(const char *s)
+{
+  char *end;
+  double v = strtod(s, &end);
+  switch (*end) {
+  case 'k': case 'K': v *= 1024.0; break;
+  case 'm': case 'M': v *= 1024.0 * 1024.0; break;
+  case 'g': case 'G': v *= 1024.0 * 1024.0 * 1024.0; break;
+  }
+  return (size_t) v;
+}
+
+static void usage(const char *prg)
+{
+  printf("Usage: %s [-x nx] [-y ny] [-t type] [-r reps] [-n threads] [-s max_bytes] [-i isa] [-I]\n"
+         "       [-a] [-c file] [-b count] [-w warmup] [-o file]\n"
+         "       [-f infile -F outfile [-m budget]]\n", prg);
+  printf("  -x nx         number of columns (default 1024)\n");
+  printf("  -y ny         number of rows (default nx)\n");
+  printf("  -t type       element type: float, double, complex (double), int8,\n");
+  printf("                fp16, bf16, or all (default float)\n");
+  printf("  -r reps       timed calls of each routine (default %d)\n", NUM_REPS);
+  printf("  -w warmup     untimed calls before them (default %d)\n", NUM_WARMUP);
+  printf("  -n threads    number of OpenMP threads (default OMP_NUM_THREADS)\n");
+  printf("  -s max_bytes  sweep the sizes from %zu bytes to max_bytes, e.g., 4G\n",
+         SWEEP_MIN_BYTES);
+  printf("  -i isa        highest instruction set of the micro-kernels:\n");
+  printf("                scalar, avx2 or avx512 (default: best of the CPU)\n");
+  printf("  -I            allocate one matrix and run only the in-place routines\n");
+  printf("  -a            tune the tile, micro-kernel and threads for the shape\n");
+  printf("  -c file       tuning cache (default %s)\n", tuneDefaultFile());
+  printf("  -b count      matrices per batch of the batched transpose\n");
+  printf("                (default: %zu MB per batch)\n", BATCH_BYTES >> 20);
+  printf("  -o file       write the results to file, as JSON if it ends in .json,\n");
+  printf("                else as CSV\n");
+  printf("  -f infile     transpose the ny x nx raw row-major matrix in infile\n");
+  printf("  -F outfile    to outfile, out of core, instead of the benchmark\n");
+  printf("  -m budget     RAM budget of the out-of-core transpose (default %zu MB)\n",
+         OOC_BUDGET >> 20);
+}
+
+int main(int argc, char **argv)
+{
+  int nx = 1024, ny = 0, reps = NUM_REPS;
+  size_t sweep_max = 0;
+  const char *type = "float", *report_file = NULL;
+  int c;
+
+  while ((c = getopt(argc, argv, "x:y:t:r:n:s:i:Iac:b:w:o:f:F:m:h")) != -1) {
+    switch (c) {
+    case 'x': nx = atoi(optarg); break;
+    case 'y': ny = atoi(optarg); break;
+    case 't': type = optarg; break;
+    case 'r': reps = atoi(optarg); break;
+    case 'n': omp_set_num_threads(atoi(optarg)); break;
+    case 's': sweep_max = parse_bytes(optarg); break;
+    case 'i':
+      for (c = ISA_AVX512; c >= ISA_SCALAR; c--)
+        if (strcmp(optarg, simd_isa_name[c]) == 0)
+          break;
+      if (c < ISA_SCALAR) {
+        usage(argv[0]);
+        return 1;
+      }
+      max_isa = (simd_isa) c;
+      break;
+    case 'I': inplace_only = true; break;
+    case 'a': tune = true; break;
+    case 'c': tune_file = optarg; break;
+    case 'b': batch_count = atoi(optarg); break;
+    case 'w': warmup = atoi(optarg); break;
+    case 'o': report_file = optarg; break;
+    case 'f': ooc_in = optarg; break;
+    case 'F': ooc_out = optarg; break;
+    case 'm': ooc_budget = parse_bytes(optarg); break;
+    case 'h': usage(argv[0]); return 0;
+    default:  usage(argv[0]); return 1;
+    }
+  }
+  if (ny == 0) ny = nx;
+
+  // check parameters
+  if (nx <= 0 || ny <= 0 || reps <= 0) {
+    printf("nx, ny and reps must be positive\n");
+    return 1;
+  }
+
+  if (batch_count < 0 || warmup < 0) {
+    printf("The batch count and warm-up calls must not be negative\n");
+    return 1;
+  }
+
+  if ((ooc_in == NULL) != (ooc_out == NULL) || (ooc_in && strcmp(type, "all") == 0)) {
+    printf("-f and -F go together, with one element type\n");
+    return 1;
+  }
+
+  if (TILE_DIM % BLOCK_ROWS) {
+    printf("TILE_DIM must be a multiple of BLOCK_ROWS\n");
+    return 1;
+  }
+
+  if (tune_file == NULL)
+    tune_file = tuneDefaultFile();
+
+  cpu_name(cpu_model, sizeof(cpu_model));
+  printf("\nDevice : %s, %d threads\n", cpu_model, omp_get_max_threads());
+
+  if (report_file && !reportOpen(report_file, cpu_model, omp_get_max_threads(), warmup)) {
+    printf("Could not create %s\n", report_file);
+    return 1;
+  }
+
+  bool all = strcmp(type, "all") == 0;
+  double gbps[NUM_TYPES][NUM_ROUTINES];
+  int ran = 0, err = 0;
+
+  for (int t = 0; t < NUM_TYPES; t++) {
+    if (!all && strcmp(type, types[t].name) != 0)
+      continue;
+    if (ran++)
+      printf("\n");
+    err |= types[t].bench(nx, ny, reps, sweep_max, gbps[t]);
+  }
+  if (ran == 0) {
+    printf("Unknown element type '%s'\n", type);
+    reportClose();
+    return 1;
+  }
+
+  // bandwidth per element type
+  if (all && !sweep_max && !ooc_in && !err) {
+    printf("\n%25s", "Bandwidth (GB/s)");
+    for (int t = 0; t < NUM_TYPES; t++)
+      printf(" %8s", types[t].name);
+    printf("\n");
+    for (int r = 0; r < NUM_ROUTINES; r++) {
+      if (inplace_only && !routines[r].inplace)
+        continue;
+      printf("%25s", routines[r].name);
+      for (int t = 0; t < NUM_TYPES; t++)
+        if (gbps[t][r] < 0)
+          printf(" %8s", "FAILED");
+        else
+          printf(" %8.2f", gbps[t][r]);
+      printf("\n");
+    }
+  }
+
+  if (!reportClose()) {
+    printf("Could not write %s\n", report_file);
+    err = 1;
+  }
+  return err;
+}
@@ -0,0 +1,342 @@
+// CPU versions of the kernels of transpose.cu
+//
+// Each kernel walks the matrix in TILE_DIM x TILE_DIM tiles, the
+// CPU analogue of a thread block, and the tiles are shared among
+// the OpenMP threads. Inside a tile, the rows are processed in
+// strips of BLOCK_ROWS rows, the way the BLOCK_ROWS threads of a
+// block step through the tile. The staging tile on the stack of
+// the thread plays the role of the shared memory tile.
+//
+// The kernels are templates on the element type. The matrices are
+// row-major and idata is ny x nx, for any nx and ny: the tiles on
+// the right and bottom edges are cut to the matrix.
+
+#ifndef TRANSPOSE_CPU_H
+#define TRANSPOSE_CPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "transpose_simd.h"
+
+const int TILE_DIM = 32;
+const int BLOCK_ROWS = 8;
+
+// Number of tiles along a dimension of n elements
+inline int numTiles(int n, int tile = TILE_DIM)
+{
+  return (n + tile - 1) / tile;
+}
+
+// Size of the tile at offset x along a dimension of n elements
+inline int tileSize(int x, int n, int tile = TILE_DIM)
+{
+  return n - x < tile ? n - x : tile;
+}
+
+// simple copy kernel
+// Used as reference case representing best effective bandwidth.
+template <typename T>
+void copy(T *odata, const T *idata, int nx, int ny)
+{
+  #pragma omp parallel for collapse(2) schedule(static)
+  for (int by = 0; by < numTiles(ny); by++)
+    for (int bx = 0; bx < numTiles(nx); bx++) {
+      int x = bx * TILE_DIM, w = tileSize(x, nx);
+      int y = by * TILE_DIM, h = tileSize(y, ny);
+
+      for (int j = 0; j < h; j += BLOCK_ROWS)
+        for (int k = j; k < j + BLOCK_ROWS && k < h; k++)
+          for (int i = 0; i < w; i++)
+            odata[(size_t)(y+k)*nx + x+i] = idata[(size_t)(y+k)*nx + x+i];
+    }
+}
+
+// copy kernel through a staging tile
+// Also used as reference case, demonstrating the cost of the staging.
+template <typename T>
+void copySharedMem(T *odata, const T *idata, int nx, int ny)
+{
+  #pragma omp parallel for collapse(2) schedule(static)
+  for (int by = 0; by < numTiles(ny); by++)
+    for (int bx = 0; bx < numTiles(nx); bx++) {
+      T tile[TILE_DIM * TILE_DIM];
+      int x = bx * TILE_DIM, w = tileSize(x, nx);
+      int y = by * TILE_DIM, h = tileSize(y, ny);
+
+      for (int j = 0; j < h; j += BLOCK_ROWS)
+        for (int k = j; k < j + BLOCK_ROWS && k < h; k++)
+          for (int i = 0; i < w; i++)
+            tile[k*TILE_DIM + i] = idata[(size_t)(y+k)*nx + x+i];
+
+      for (int j = 0; j < h; j += BLOCK_ROWS)
+        for (int k = j; k < j + BLOCK_ROWS && k < h; k++)
+          for (int i = 0; i < w; i++)
+            odata[(size_t)(y+k)*nx + x+i] = tile[k*TILE_DIM + i];
+    }
+}
+
+// naive transpose
+// Row by row over the whole matrix: the reads are sequential, the
+// writes stride through odata by ny elements.
+template <typename T>
+void transposeNaive(T *odata, const T *idata, int nx, int ny)
+{
+  #pragma omp parallel for schedule(static)
+  for (int y = 0; y < ny; y++)
+    for (int x = 0; x < nx; x++)
+      odata[(size_t)x*ny + y] = idata[(size_t)y*nx + x];
+}
+
+// blocked transpose through a staging tile with PAD extra columns
+template <typename T, int PAD>
+void transposeStaged(T *odata, const T *idata, int nx, int ny)
+{
+  #pragma omp parallel for collapse(2) schedule(static)
+  for (int by = 0; by < numTiles(ny); by++)
+    for (int bx = 0; bx < numTiles(nx); bx++) {
+      T tile[TILE_DIM][TILE_DIM+PAD];
+      int x = bx * TILE_DIM, w = tileSize(x, nx);
+      int y = by * TILE_DIM, h = tileSize(y, ny);
+
+      for (int j = 0; j < h; j += BLOCK_ROWS)
+        for (int k = j; k < j + BLOCK_ROWS && k < h; k++)
+          for (int i = 0; i < w; i++)
+            tile[k][i] = idata[(size_t)(y+k)*nx + x+i];
+
+      // transpose block offset: the tile is w x h in odata
+      for (int j = 0; j < w; j += BLOCK_ROWS)
+        for (int k = j; k < j + BLOCK_ROWS && k < w; k++)
+          for (int i = 0; i < h; i++)
+            odata[(size_t)(x+k)*ny + y+i] = tile[i][k];
+    }
+}
+
+// blocked transpose
+// Stages a tile so that both the reads and the writes walk rows
+// of the tile. With a tile row of a power of two bytes, the column
+// reads of the tile map to few cache sets.
+template <typename T>
+void transposeCoalesced(T *odata, const T *idata, int nx, int ny)
+{
+  transposeStaged<T, 0>(odata, idata, nx, ny);
+}
+
+// blocked transpose with a padded staging tile
+// Same as transposeCoalesced except the rows of the tile are padded
+// by one element, so the column reads of the tile fall in different
+// cache sets: the CPU analogue of the TILE_DIM+1 bank-conflict trick.
+template <typename T>
+void transposeNoBankConflicts(T *odata, const T *idata, int nx, int ny)
+{
+  transposeStaged<T, 1>(odata, idata, nx, ny);
+}
+
+// Transpose the h x w block at (x, y) of idata in mk.dim x mk.dim
+// blocks with the micro-kernel; the rows and columns that do not fill
+// a block are transposed element by element
+template <typename T>
+inline void transposeBlock(T *odata, const T *idata, int nx, int ny,
+                           int x, int y, int w, int h, const microKernel<T> &mk)
+{
+  const int d = mk.dim;
+  int wd = w - w % d, hd = h - h % d;
+
+  for (int j = 0; j < hd; j += d)
+    for (int i = 0; i < wd; i += d)
+      mk.fn(&odata[(size_t)(x+i)*ny + y+j], ny, &idata[(size_t)(y+j)*nx + x+i], nx);
+
+  // edges
+  for (int k = 0; k < h; k++)
+    for (int i = (k < hd ? wd : 0); i < w; i++)
+      odata[(size_t)(x+i)*ny + y+k] = idata[(size_t)(y+k)*nx + x+i];
+}
+
+// blocked transpose with in-register micro-kernels
+// Each tile is transposed by the SIMD micro-kernel (see
+// transpose_simd.h), straight from idata to odata with no staging
+// tile. The tile is a run-time parameter, a multiple of mk.dim, so
+// it can be tuned.
+template <typename T>
+void transposeSimd(T *odata, const T *idata, int nx, int ny, const microKernel<T> &mk,
+                   int tile = TILE_DIM)
+{
+  #pragma omp parallel for collapse(2) schedule(static)
+  for (int by = 0; by < numTiles(ny, tile); by++)
+    for (int bx = 0; bx < numTiles(nx, tile); bx++) {
+      int x = bx * tile, w = tileSize(x, nx, tile);
+      int y = by * tile, h = tileSize(y, ny, tile);
+
+      transposeBlock(odata, idata, nx, ny, x, y, w, h, mk);
+    }
+}
+
+// Largest side of a leaf of the recursive transpose: a few
+// micro-kernel blocks, and at least two
+const int RECURSE_LEAF = 32;
+
+// Transpose the h x w block at (x, y): split the longer side in
+// two, at a multiple of mk.dim, down to RECURSE_LEAF; the halves
+// are OpenMP tasks down to task_depth levels
+template <typename T>
+void transposeRecurse(T *odata, const T *idata, int nx, int ny,
+                      int x, int y, int w, int h, const microKernel<T> &mk, int task_depth)
+{
+  int leaf = RECURSE_LEAF > 2 * mk.dim ? RECURSE_LEAF : 2 * mk.dim;
+
+  if (w <= leaf && h <= leaf) {
+    transposeBlock(odata, idata, nx, ny, x, y, w, h, mk);
+    return;
+  }
+
+  int x2 = x, y2 = y, w1 = w, h1 = h;
+  if (w >= h) {
+    w1 = w / 2 - w / 2 % mk.dim;
+    x2 = x + w1;
+  } else {
+    h1 = h / 2 - h / 2 % mk.dim;
+    y2 = y + h1;
+  }
+  int w2 = w >= h ? w - w1 : w;
+  int h2 = w >= h ? h : h - h1;
+
+  if (task_depth > 0) {
+    #pragma omp task
+    transposeRecurse(odata, idata, nx, ny, x, y, w1, h1, mk, task_depth - 1);
+    transposeRecurse(odata, idata, nx, ny, x2, y2, w2, h2, mk, task_depth - 1);
+    #pragma omp taskwait
+  } else {
+    transposeRecurse(odata, idata, nx, ny, x, y, w1, h1, mk, 0);
+    transposeRecurse(odata, idata, nx, ny, x2, y2, w2, h2, mk, 0);
+  }
+}
+
+// cache-oblivious transpose
+// Halving the longer side gives blocks that fit each cache level at
+// some depth of the recursion, with no tile to tune. Tasks are
+// spawned at the top levels only, about 8 leaves of tasks per thread.
+template <typename T>
+void transposeRecursive(T *odata, const T *idata, int nx, int ny, const microKernel<T> &mk)
+{
+  #pragma omp parallel
+  #pragma omp single
+  {
+    int task_depth = 3;
+    for (int t = 1; t < omp_get_num_threads(); t *= 2)
+      task_depth++;
+    transposeRecurse(odata, idata, nx, ny, 0, 0, nx, ny, mk, task_depth);
+  }
+}
+
+// batched transpose
+// count ny x nx matrices, matrix b at idata + b*istride, each to its
+// nx x ny transpose at odata + b*ostride. Small matrices leave no
+// parallelism inside one, so the threads share the batch in a single
+// parallel region, one matrix at a time, with mk picked for the
+// shape (see selectMicroKernel).
+template <typename T>
+void transposeBatched(T *odata, const T *idata, int nx, int ny, int count,
+                      size_t ostride, size_t istride, const microKernel<T> &mk)
+{
+  #pragma omp parallel for schedule(static)
+  for (int b = 0; b < count; b++)
+    transposeBlock(odata + b*ostride, idata + b*istride, nx, ny, 0, 0, nx, ny, mk);
+}
+
+// in-place transpose of a square matrix
+// The tiles above the diagonal are swapped with their mirror tiles
+// below it, each pair through two staging tiles; the diagonal tiles
+// are transposed through the same path, with a and b the same tile.
+template <typename T>
+void transposeInPlaceSquare(T *data, int n)
+{
+  #pragma omp parallel for schedule(dynamic)
+  for (int by = 0; by < numTiles(n); by++)
+    for (int bx = by; bx < numTiles(n); bx++) {
+      T a[TILE_DIM][TILE_DIM+1], b[TILE_DIM][TILE_DIM+1];
+      int x = bx * TILE_DIM, w = tileSize(x, n);
+      int y = by * TILE_DIM, h = tileSize(y, n);
+
+      // tile (by, bx) is h x w, its mirror (bx, by) is w x h
+      for (int k = 0; k < h; k++)
+        for (int i = 0; i < w; i++)
+          a[k][i] = data[(size_t)(y+k)*n + x+i];
+      for (int k = 0; k < w; k++)
+        for (int i = 0; i < h; i++)
+          b[k][i] = data[(size_t)(x+k)*n + y+i];
+
+      for (int k = 0; k < w; k++)
+        for (int i = 0; i < h; i++)
+          data[(size_t)(x+k)*n + y+i] = a[i][k];
+      for (int k = 0; k < h; k++)
+        for (int i = 0; i < w; i++)
+          data[(size_t)(y+k)*n + x+i] = b[i][k];
+    }
+}
+
+// in-place transpose of a rectangular matrix by cycle following
+// The element at p = y*nx + x moves to x*ny + y, and the moves form
+// disjoint cycles. A serial pass walks the permutation, marking the
+// positions in a visited bit-vector, and records the first position
+// of each cycle in a leader bit-vector; the cycles are then rotated
+// in parallel. The two bit-vectors take 2 bits per element.
+template <typename T>
+bool transposeInPlaceCycles(T *data, int nx, int ny)
+{
+  size_t n = (size_t) nx * ny;
+  size_t nwords = (n + 63) / 64;
+  uint64_t *visited = (uint64_t *) calloc(nwords, sizeof(uint64_t));
+  uint64_t *leader  = (uint64_t *) calloc(nwords, sizeof(uint64_t));
+
+  if (visited == NULL || leader == NULL) {
+    free(visited);
+    free(leader);
+    return false;
+  }
+
+  for (size_t s = 0; s < n; s++) {
+    if (visited[s / 64] >> (s % 64) & 1)
+      continue;
+    size_t p = s;
+    do {
+      visited[p / 64] |= (uint64_t) 1 << (p % 64);
+      p = (p % nx) * ny + p / nx;
+    } while (p != s);
+    if ((s % nx) * ny + s / nx != s)
+      leader[s / 64] |= (uint64_t) 1 << (s % 64);
+  }
+  free(visited);
+
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (size_t w = 0; w < nwords; w++)
+    for (uint64_t bits = leader[w]; bits; bits &= bits - 1) {
+      size_t s = w * 64 + __builtin_ctzll(bits), p = s;
+      T v = data[s];
+      do {
+        p = (p % nx) * ny + p / nx;
+        T t = data[p];
+        data[p] = v;
+        v = t;
+      } while (p != s);
+    }
+
+  free(leader);
+  return true;
+}
+
+// in-place transpose
+// data holds a ny x nx matrix on entry and its nx x ny transpose on
+// exit, so no second matrix is needed; false if out of memory.
+template <typename T>
+bool transposeInPlace(T *data, int nx, int ny)
+{
+  if (nx == ny) {
+    transposeInPlaceSquare(data, nx);
+    return true;
+  }
+  return transposeInPlaceCycles(data, nx, ny);
+}
+
+#endif
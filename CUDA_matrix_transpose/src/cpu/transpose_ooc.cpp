@@ -0,0 +1,135 @@
+// File I/O of the out-of-core transpose
+//
+// The reads and writes go through the page cache with pread and
+// pwrite, one call per run of the block, or one call for the whole
+// block when its runs are adjacent in the file. The output is
+// allocated up front, and flushed to disk before the transpose is
+// timed as done.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "transpose_ooc.h"
+
+void oocBlock(int nx, int ny, size_t elem, size_t budget, int *w, int *h)
+{
+  size_t cells = budget / 4 / elem;
+  if (cells < 1)
+    cells = 1;
+
+  // reads of OOC_MIN_RUN, but no longer than the writes
+  size_t cols = OOC_MIN_RUN / elem, side = (size_t) sqrt((double) cells);
+  if (cols > side)
+    cols = side;
+  if (cols > (size_t) nx)
+    cols = nx;
+  if (cols < 1)
+    cols = 1;
+
+  size_t rows = cells / cols, align = OOC_ALIGN / elem;
+  if (rows >= (size_t) ny) {
+    // whole columns: the transposed block is one run of the output
+    *h = ny;
+    *w = cells / ny < (size_t) nx ? (int) (cells / ny) : nx;
+    return;
+  }
+  if (rows >= align)
+    rows -= rows % align;
+  *w = (int) cols;
+  *h = (int) rows;
+}
+
+bool oocOpen(const char *in, const char *out, size_t bytes, int *ifd, int *ofd)
+{
+  struct stat sb;
+
+  if ((*ifd = open(in, O_RDONLY)) < 0) {
+    printf("Could not open %s: %s\n", in, strerror(errno));
+    return false;
+  }
+  if (fstat(*ifd, &sb) != 0 || (size_t) sb.st_size != bytes) {
+    printf("%s holds %lld bytes, not %zu\n", in, (long long) sb.st_size, bytes);
+    close(*ifd);
+    return false;
+  }
+  posix_fadvise(*ifd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  if ((*ofd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    printf("Could not create %s: %s\n", out, strerror(errno));
+    close(*ifd);
+    return false;
+  }
+  // allocate the output in one piece, where the file system can
+  int err = posix_fallocate(*ofd, 0, bytes);
+  if (err != 0 && err != EOPNOTSUPP && err != EINVAL) {
+    printf("Could not allocate %zu bytes for %s: %s\n", bytes, out, strerror(err));
+    close(*ifd);
+    close(*ofd);
+    return false;
+  }
+  return true;
+}
+
+// Read or write len bytes at offset, through short transfers
+static bool transfer(int fd, char *buf, size_t len, off_t offset, bool write)
+{
+  while (len > 0) {
+    ssize_t n = write ? pwrite(fd, buf, len, offset) : pread(fd, buf, len, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      printf("Could not %s %zu bytes at offset %lld: %s\n", write ? "write" : "read",
+             len, (long long) offset, n < 0 ? strerror(errno) : "end of file");
+      return false;
+    }
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return true;
+}
+
+bool oocRead(int fd, void *buf, int nx, int x, int y, int w, int h, size_t elem)
+{
+  char *p = (char *) buf;
+
+  if (w == nx)
+    return transfer(fd, p, (size_t) w * h * elem, (off_t) y * nx * elem, false);
+  for (int j = 0; j < h; j++)
+    if (!transfer(fd, p + (size_t) j * w * elem, (size_t) w * elem,
+                  ((off_t) (y+j) * nx + x) * elem, false))
+      return false;
+  return true;
+}
+
+bool oocWrite(int fd, const void *buf, int ny, int x, int y, int w, int h, size_t elem)
+{
+  char *p = (char *) buf;
+
+  if (h == ny)
+    return transfer(fd, p, (size_t) w * h * elem, (off_t) x * ny * elem, true);
+  for (int i = 0; i < w; i++)
+    if (!transfer(fd, p + (size_t) i * h * elem, (size_t) h * elem,
+                  ((off_t) (x+i) * ny + y) * elem, true))
+      return false;
+  return true;
+}
+
+bool oocClose(int ifd, int ofd)
+{
+  bool ok = true;
+
+  if (fdatasync(ofd) != 0) {
+    printf("Could not flush the output: %s\n", strerror(errno));
+    ok = false;
+  }
+  close(ifd);
+  if (close(ofd) != 0)
+    ok = false;
+  return ok;
+}
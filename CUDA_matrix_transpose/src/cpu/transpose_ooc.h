@@ -0,0 +1,131 @@
+// Out-of-core transpose of a raw file
+//
+// Transposes a ny x nx row-major matrix stored as a raw file into a
+// nx x ny raw file, for matrices larger than memory. The input is
+// read in blocks of h rows of w columns sized to a RAM budget, each
+// block is transposed in memory by transposeSimd, and the w rows of
+// h elements of its transpose are written back. The block is made as
+// tall as the budget allows: with h = ny, the rows of the transposed
+// block are adjacent in the output and go out as one write; else
+// its reads are up to OOC_MIN_RUN bytes, and its writes as long.
+//
+// The blocks are double-buffered: while the threads transpose block
+// k, an I/O thread writes block k-1 and reads block k+1, so when the
+// disk is slower than the transpose the run time is that of the I/O.
+
+#ifndef TRANSPOSE_OOC_H
+#define TRANSPOSE_OOC_H
+
+#include <stdlib.h>
+#include <omp.h>
+
+#include "transpose_cpu.h"
+
+// Shortest read or write of a block, in bytes
+const size_t OOC_MIN_RUN = 64 << 10;
+
+// Alignment of the buffers, and of the runs when the block allows
+const size_t OOC_ALIGN = 4096;
+
+// Default RAM budget of the buffers
+const size_t OOC_BUDGET = (size_t) 1 << 30;
+
+struct oocStats {
+  int    w, h;                // block: h rows of w columns of the input
+  int    blocks;
+  double seconds;             // with the final flush to disk
+  double io_seconds;          // busy time of the I/O thread
+  double transpose_seconds;
+};
+
+// Block of the transpose of a ny x nx matrix of elem byte elements:
+// the budget holds four h x w buffers, two for reading, two for writing
+void oocBlock(int nx, int ny, size_t elem, size_t budget, int *w, int *h);
+
+// Open in, check that it holds bytes, and create out of that size;
+// false with a message on error
+bool oocOpen(const char *in, const char *out, size_t bytes, int *ifd, int *ofd);
+
+// Read the h x w block at (x, y) of the ny x nx input into buf
+bool oocRead(int fd, void *buf, int nx, int x, int y, int w, int h, size_t elem);
+
+// Write the w x h transpose in buf of the block at (x, y) to the
+// nx x ny output
+bool oocWrite(int fd, const void *buf, int ny, int x, int y, int w, int h, size_t elem);
+
+// Flush out to disk and close both files
+bool oocClose(int ifd, int ofd);
+
+// out-of-core transpose
+// The blocks go down the columns of the input, so that the output is
+// written from start to end; false with a message on error.
+template <typename T>
+bool transposeFile(const char *in, const char *out, int nx, int ny, size_t budget,
+                   const microKernel<T> &mk, oocStats *st)
+{
+  int ifd, ofd;
+  void *buf[4] = { NULL, NULL, NULL, NULL };
+
+  if (!oocOpen(in, out, (size_t) nx * ny * sizeof(T), &ifd, &ofd))
+    return false;
+
+  oocBlock(nx, ny, sizeof(T), budget, &st->w, &st->h);
+  const int w = st->w, h = st->h, by = numTiles(ny, h);
+  const int n = st->blocks = numTiles(nx, w) * by;
+  bool ok = true;
+  for (int i = 0; i < 4; i++)
+    if (posix_memalign(&buf[i], OOC_ALIGN, (size_t) w * h * sizeof(T)) != 0) {
+      printf("Could not allocate 4 x %zu bytes\n", (size_t) w * h * sizeof(T));
+      ok = false;
+      break;
+    }
+  T **ibuf = (T **) buf, **obuf = (T **) buf + 2;
+
+  // the transpose runs nested in its section
+  int levels = omp_get_max_active_levels();
+  omp_set_max_active_levels(2);
+
+  double start = omp_get_wtime();
+  st->io_seconds = st->transpose_seconds = 0;
+  if (ok)
+    ok = oocRead(ifd, ibuf[0], nx, 0, 0, w, tileSize(0, ny, h), sizeof(T));
+  st->io_seconds = omp_get_wtime() - start;
+
+  for (int k = 0; k <= n && ok; k++) {
+    #pragma omp parallel sections num_threads(2)
+    {
+      #pragma omp section
+      {
+        double t = omp_get_wtime();
+        if (k > 0) {
+          int x = (k-1) / by * w, y = (k-1) % by * h;
+          ok = oocWrite(ofd, obuf[(k-1) % 2], ny, x, y, tileSize(x, nx, w), tileSize(y, ny, h),
+                        sizeof(T));
+        }
+        if (ok && k + 1 < n) {
+          int x = (k+1) / by * w, y = (k+1) % by * h;
+          ok = oocRead(ifd, ibuf[(k+1) % 2], nx, x, y, tileSize(x, nx, w), tileSize(y, ny, h),
+                       sizeof(T));
+        }
+        st->io_seconds += omp_get_wtime() - t;
+      }
+      #pragma omp section
+      if (k < n) {
+        double t = omp_get_wtime();
+        int x = k / by * w, y = k % by * h;
+        transposeSimd(obuf[k % 2], ibuf[k % 2], tileSize(x, nx, w), tileSize(y, ny, h), mk);
+        st->transpose_seconds += omp_get_wtime() - t;
+      }
+    }
+  }
+  omp_set_max_active_levels(levels);
+
+  if (!oocClose(ifd, ofd))
+    ok = false;
+  st->seconds = omp_get_wtime() - start;
+  for (int i = 0; i < 4; i++)
+    free(buf[i]);
+  return ok;
+}
+
+#endif
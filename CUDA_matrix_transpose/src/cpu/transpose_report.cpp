@@ -0,0 +1,147 @@
+// Statistics and report file of the CPU transpose benchmark
+//
+// The CSV file has a header line and one line per record; the JSON
+// file holds the run (revision, CPU, threads, warm-up calls) and an
+// array of records. The revision is given by the Makefile, from git.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "transpose_report.h"
+
+#ifndef REVISION
+#define REVISION "unknown"
+#endif
+
+static FILE *report = NULL;
+static bool  json;
+static int   records;
+static char  run_model[256];
+static int   run_threads, run_warmup;
+
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile p of n sorted values
+static double percentile(const double *sorted, int n, double p)
+{
+  int i = (int) ceil(p * n) - 1;
+  return sorted[i < 0 ? 0 : i];
+}
+
+benchStats benchSummary(const double *seconds, int reps, double bytes)
+{
+  benchStats s = { reps, 0, 0, 0, 0 };
+  double *bw = (double *) malloc(reps * sizeof(double));
+  double sum = 0, sum2 = 0;
+
+  if (bw == NULL || reps <= 0) {
+    free(bw);
+    return s;
+  }
+  for (int i = 0; i < reps; i++) {
+    bw[i] = bytes * 1e-9 / seconds[i];
+    sum += bw[i];
+  }
+  qsort(bw, reps, sizeof(double), cmp_double);
+
+  double mean = sum / reps;
+  for (int i = 0; i < reps; i++)
+    sum2 += (bw[i] - mean) * (bw[i] - mean);
+
+  s.median = reps % 2 ? bw[reps / 2] : (bw[reps / 2 - 1] + bw[reps / 2]) / 2;
+  s.p5  = percentile(bw, reps, 0.05);
+  s.p95 = percentile(bw, reps, 0.95);
+  s.cv  = sqrt(sum2 / reps) / mean;
+  free(bw);
+  return s;
+}
+
+// Write s as a quoted CSV field or JSON string
+static void put_string(const char *s)
+{
+  fputc('"', report);
+  for (; *s; s++) {
+    if (*s == '"')
+      fputc(json ? '\\' : '"', report);
+    else if (*s == '\\' && json)
+      fputc('\\', report);
+    fputc(*s, report);
+  }
+  fputc('"', report);
+}
+
+bool reportOpen(const char *file, const char *model, int threads, int warmup)
+{
+  size_t len = strlen(file);
+
+  if ((report = fopen(file, "w")) == NULL)
+    return false;
+  json = len >= 5 && strcmp(file + len - 5, ".json") == 0;
+  records = 0;
+  snprintf(run_model, sizeof(run_model), "%s", model);
+  run_threads = threads;
+  run_warmup = warmup;
+
+  if (json) {
+    fprintf(report, "{\n  \"revision\": ");
+    put_string(REVISION);
+    fprintf(report, ",\n  \"cpu\": ");
+    put_string(model);
+    fprintf(report, ",\n  \"threads\": %d,\n  \"warmup\": %d,\n  \"results\": [", threads, warmup);
+  } else
+    fprintf(report, "revision,cpu,threads,warmup,type,routine,nx,ny,batch,reps,"
+                    "median_gbps,p5_gbps,p95_gbps,cv,pct_copy\n");
+  return true;
+}
+
+void reportWrite(const char *type, const char *routine, int nx, int ny, int batch,
+                 const benchStats &s, double pct_copy)
+{
+  if (report == NULL)
+    return;
+
+  if (json) {
+    fprintf(report, "%s\n    { \"type\": ", records ? "," : "");
+    put_string(type);
+    fprintf(report, ", \"routine\": ");
+    put_string(routine);
+    fprintf(report, ", \"nx\": %d, \"ny\": %d, \"batch\": %d, \"reps\": %d, "
+                    "\"median_gbps\": %.3f, \"p5_gbps\": %.3f, \"p95_gbps\": %.3f, \"cv\": %.4f, ",
+            nx, ny, batch, s.reps, s.median, s.p5, s.p95, s.cv);
+    if (pct_copy < 0)
+      fprintf(report, "\"pct_copy\": null }");
+    else
+      fprintf(report, "\"pct_copy\": %.1f }", pct_copy);
+  } else {
+    put_string(REVISION);
+    fputc(',', report);
+    put_string(run_model);
+    fprintf(report, ",%d,%d,%s,", run_threads, run_warmup, type);
+    put_string(routine);
+    fprintf(report, ",%d,%d,%d,%d,%.3f,%.3f,%.3f,%.4f,", nx, ny, batch, s.reps,
+            s.median, s.p5, s.p95, s.cv);
+    if (pct_copy >= 0)
+      fprintf(report, "%.1f", pct_copy);
+    fputc('\n', report);
+  }
+  records++;
+}
+
+bool reportClose()
+{
+  if (report == NULL)
+    return true;
+  if (json)
+    fprintf(report, "\n  ]\n}\n");
+  bool ok = !ferror(report);
+  if (fclose(report) != 0)
+    ok = false;
+  report = NULL;
+  return ok;
+}
@@ -0,0 +1,38 @@
+// Statistics and machine-readable output of the benchmark
+//
+// Each routine is timed call by call, and the bandwidth of the calls
+// is summarized by its median, which a few slow calls (a page fault,
+// a preempted thread) do not move, its 5th and 95th percentiles and
+// its coefficient of variation. The results can also be written to a
+// CSV or JSON file, one record per routine and shape, along with the
+// CPU, the threads and the revision of the code, so that they can be
+// compared across nodes and commits.
+
+#ifndef TRANSPOSE_REPORT_H
+#define TRANSPOSE_REPORT_H
+
+// Bandwidth of the timed calls of a routine
+struct benchStats {
+  int    reps;
+  double median;      // GB/s
+  double p5, p95;     // GB/s
+  double cv;          // standard deviation over mean
+};
+
+// Statistics of reps calls moving bytes each, from their times in seconds
+benchStats benchSummary(const double *seconds, int reps, double bytes);
+
+// Open the report: JSON if file ends in .json, else CSV; false if
+// it cannot be created
+bool reportOpen(const char *file, const char *model, int threads, int warmup);
+
+// Add the result of a routine on a batch of ny x nx matrices (batch
+// 1 for one matrix); pct_copy is the median as a percentage of that
+// of copy, negative if copy did not run
+void reportWrite(const char *type, const char *routine, int nx, int ny, int batch,
+                 const benchStats &s, double pct_copy);
+
+// Close the report; false if it could not be written
+bool reportClose();
+
+#endif
@@ -0,0 +1,359 @@
+// In-register transpose micro-kernels
+//
+// A micro-kernel transposes a DIM x DIM block held in vector
+// registers: DIM loads of rows of src, a network of unpack and
+// shuffle instructions, and DIM stores of rows of dst. It is the
+// leaf of the blocked kernels: the blocking keeps the rows in
+// cache, the micro-kernel moves the elements.
+//
+//   size  DIM                 instructions
+//    1    32 x 32  AVX2       unpack, permute2x128
+//    2    16 x 16  AVX2       unpack, permute2x128
+//    4    16 x 16  AVX-512F   unpack, shuffle, shuffle_f32x4
+//    4     8 x 8   AVX2       unpack, shuffle, permute2f128
+//    8     8 x 8   AVX-512F   unpack, shuffle_f64x2
+//    8     4 x 4   AVX2       unpack, permute2f128
+//   16     4 x 4   AVX-512F   shuffle_f64x2
+//   16     2 x 2   AVX2       permute2f128
+//
+// The kernels depend only on the size of the element, so they serve
+// every type of that size (float and int32, double and int64, ...).
+// The kernel is selected at run time from the instruction sets the
+// CPU reports through CPUID, with a scalar fallback of the same
+// DIM, so one binary runs on every node.
+
+#ifndef TRANSPOSE_SIMD_H
+#define TRANSPOSE_SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+// GCC 12 warns about the self-initialized undefined vectors of its
+// own AVX-512 intrinsics (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+
+// Instruction sets, in increasing order
+enum simd_isa { ISA_SCALAR, ISA_AVX2, ISA_AVX512 };
+
+const char *const simd_isa_name[] = { "scalar", "avx2", "avx512" };
+
+// Highest instruction set of the CPU
+inline simd_isa cpuIsa()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return ISA_AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return ISA_AVX2;
+  return ISA_SCALAR;
+}
+
+// dst[i*ldd + j] = src[j*lds + i] for a DIM x DIM block
+template <typename T>
+struct microKernel {
+  simd_isa isa;
+  int      dim;
+  void   (*fn)(T *dst, size_t ldd, const T *src, size_t lds);
+};
+
+// scalar micro-kernel
+template <typename T, int DIM>
+void transposeMicro(T *dst, size_t ldd, const T *src, size_t lds)
+{
+  for (int i = 0; i < DIM; i++)
+    for (int j = 0; j < DIM; j++)
+      dst[i*ldd + j] = src[j*lds + i];
+}
+
+// 8 x 8 float
+// Unpack interleaves pairs of rows, shuffle gathers 4-element
+// columns in each 128-bit lane, permute2f128 joins the lanes.
+__attribute__((target("avx2")))
+inline void transposeMicro8x8_avx2(float *dst, size_t ldd, const float *src, size_t lds)
+{
+  __m256 r[8], t[8], s[8];
+
+  for (int k = 0; k < 8; k++)
+    r[k] = _mm256_loadu_ps(src + k*lds);
+
+  for (int k = 0; k < 4; k++) {
+    t[2*k]   = _mm256_unpacklo_ps(r[2*k], r[2*k+1]);
+    t[2*k+1] = _mm256_unpackhi_ps(r[2*k], r[2*k+1]);
+  }
+
+  for (int k = 0; k < 2; k++) {
+    s[4*k]   = _mm256_shuffle_ps(t[4*k],   t[4*k+2], 0x44);
+    s[4*k+1] = _mm256_shuffle_ps(t[4*k],   t[4*k+2], 0xee);
+    s[4*k+2] = _mm256_shuffle_ps(t[4*k+1], t[4*k+3], 0x44);
+    s[4*k+3] = _mm256_shuffle_ps(t[4*k+1], t[4*k+3], 0xee);
+  }
+
+  for (int k = 0; k < 4; k++) {
+    r[k]   = _mm256_permute2f128_ps(s[k], s[k+4], 0x20);
+    r[k+4] = _mm256_permute2f128_ps(s[k], s[k+4], 0x31);
+  }
+
+  for (int k = 0; k < 8; k++)
+    _mm256_storeu_ps(dst + k*ldd, r[k]);
+}
+
+// 16 x 16 float
+// Same as the 8 x 8 kernel up to the 4-element columns in each
+// 128-bit lane; two rounds of shuffle_f32x4 then gather the lanes.
+__attribute__((target("avx512f")))
+inline void transposeMicro16x16_avx512(float *dst, size_t ldd, const float *src, size_t lds)
+{
+  __m512 r[16], t[16];
+
+  for (int k = 0; k < 16; k++)
+    r[k] = _mm512_loadu_ps(src + k*lds);
+
+  for (int k = 0; k < 8; k++) {
+    t[2*k]   = _mm512_unpacklo_ps(r[2*k], r[2*k+1]);
+    t[2*k+1] = _mm512_unpackhi_ps(r[2*k], r[2*k+1]);
+  }
+
+  for (int k = 0; k < 4; k++) {
+    r[4*k]   = _mm512_shuffle_ps(t[4*k],   t[4*k+2], 0x44);
+    r[4*k+1] = _mm512_shuffle_ps(t[4*k],   t[4*k+2], 0xee);
+    r[4*k+2] = _mm512_shuffle_ps(t[4*k+1], t[4*k+3], 0x44);
+    r[4*k+3] = _mm512_shuffle_ps(t[4*k+1], t[4*k+3], 0xee);
+  }
+
+  for (int k = 0; k < 2; k++)
+    for (int c = 0; c < 4; c++) {
+      t[8*k+c]   = _mm512_shuffle_f32x4(r[8*k+c], r[8*k+4+c], 0x88);
+      t[8*k+4+c] = _mm512_shuffle_f32x4(r[8*k+c], r[8*k+4+c], 0xdd);
+    }
+
+  for (int c = 0; c < 8; c++) {
+    r[c]   = _mm512_shuffle_f32x4(t[c], t[8+c], 0x88);
+    r[8+c] = _mm512_shuffle_f32x4(t[c], t[8+c], 0xdd);
+  }
+
+  for (int k = 0; k < 16; k++)
+    _mm512_storeu_ps(dst + k*ldd, r[k]);
+}
+
+// 4 x 4 double
+__attribute__((target("avx2")))
+inline void transposeMicro4x4_avx2(double *dst, size_t ldd, const double *src, size_t lds)
+{
+  __m256d r[4], t[4];
+
+  for (int k = 0; k < 4; k++)
+    r[k] = _mm256_loadu_pd(src + k*lds);
+
+  t[0] = _mm256_unpacklo_pd(r[0], r[1]);
+  t[1] = _mm256_unpackhi_pd(r[0], r[1]);
+  t[2] = _mm256_unpacklo_pd(r[2], r[3]);
+  t[3] = _mm256_unpackhi_pd(r[2], r[3]);
+
+  r[0] = _mm256_permute2f128_pd(t[0], t[2], 0x20);
+  r[1] = _mm256_permute2f128_pd(t[1], t[3], 0x20);
+  r[2] = _mm256_permute2f128_pd(t[0], t[2], 0x31);
+  r[3] = _mm256_permute2f128_pd(t[1], t[3], 0x31);
+
+  for (int k = 0; k < 4; k++)
+    _mm256_storeu_pd(dst + k*ldd, r[k]);
+}
+
+// 8 x 8 double
+// Unpack pairs the rows in each 128-bit lane, then two rounds of
+// shuffle_f64x2 gather the lanes, as in the 16 x 16 float kernel.
+__attribute__((target("avx512f")))
+inline void transposeMicro8x8_avx512(double *dst, size_t ldd, const double *src, size_t lds)
+{
+  __m512d r[8], t[8];
+
+  for (int k = 0; k < 8; k++)
+    r[k] = _mm512_loadu_pd(src + k*lds);
+
+  for (int k = 0; k < 4; k++) {
+    t[2*k]   = _mm512_unpacklo_pd(r[2*k], r[2*k+1]);
+    t[2*k+1] = _mm512_unpackhi_pd(r[2*k], r[2*k+1]);
+  }
+
+  for (int k = 0; k < 2; k++)
+    for (int c = 0; c < 2; c++) {
+      r[4*k+c]   = _mm512_shuffle_f64x2(t[4*k+c], t[4*k+2+c], 0x88);
+      r[4*k+2+c] = _mm512_shuffle_f64x2(t[4*k+c], t[4*k+2+c], 0xdd);
+    }
+
+  for (int c = 0; c < 4; c++) {
+    t[c]   = _mm512_shuffle_f64x2(r[c], r[4+c], 0x88);
+    t[4+c] = _mm512_shuffle_f64x2(r[c], r[4+c], 0xdd);
+  }
+
+  for (int k = 0; k < 8; k++)
+    _mm512_storeu_pd(dst + k*ldd, t[k]);
+}
+
+// 2 x 2 of 16-byte elements: one 128-bit lane per element
+__attribute__((target("avx2")))
+inline void transposeMicro2x2_avx2(__m128d *dst, size_t ldd, const __m128d *src, size_t lds)
+{
+  __m256d r0 = _mm256_loadu_pd((const double *) src);
+  __m256d r1 = _mm256_loadu_pd((const double *) (src + lds));
+
+  _mm256_storeu_pd((double *) dst,         _mm256_permute2f128_pd(r0, r1, 0x20));
+  _mm256_storeu_pd((double *) (dst + ldd), _mm256_permute2f128_pd(r0, r1, 0x31));
+}
+
+// 4 x 4 of 16-byte elements: two rounds of shuffle_f64x2
+__attribute__((target("avx512f")))
+inline void transposeMicro4x4_avx512(__m128d *dst, size_t ldd, const __m128d *src, size_t lds)
+{
+  __m512d r[4], t[4];
+
+  for (int k = 0; k < 4; k++)
+    r[k] = _mm512_loadu_pd((const double *) (src + k*lds));
+
+  t[0] = _mm512_shuffle_f64x2(r[0], r[1], 0x88);
+  t[1] = _mm512_shuffle_f64x2(r[0], r[1], 0xdd);
+  t[2] = _mm512_shuffle_f64x2(r[2], r[3], 0x88);
+  t[3] = _mm512_shuffle_f64x2(r[2], r[3], 0xdd);
+
+  r[0] = _mm512_shuffle_f64x2(t[0], t[2], 0x88);
+  r[1] = _mm512_shuffle_f64x2(t[1], t[3], 0x88);
+  r[2] = _mm512_shuffle_f64x2(t[0], t[2], 0xdd);
+  r[3] = _mm512_shuffle_f64x2(t[1], t[3], 0xdd);
+
+  for (int k = 0; k < 4; k++)
+    _mm512_storeu_pd((double *) (dst + k*ldd), r[k]);
+}
+
+// Unpack network of n rows in each 128-bit lane: repeating
+// a[2k] = unpacklo(a[k], a[k+n/2]), a[2k+1] = unpackhi(a[k], a[k+n/2])
+// log2(n) times, with the unpack of the element size, transposes
+// the n x n block of each lane
+#define UNPACK_NETWORK(a, n, rounds, bits)                              \
+  for (int round = 0; round < (rounds); round++) {                      \
+    __m256i b_[n];                                                      \
+    for (int k = 0; k < (n) / 2; k++) {                                 \
+      b_[2*k]   = _mm256_unpacklo_epi##bits(a[k], a[k + (n) / 2]);       \
+      b_[2*k+1] = _mm256_unpackhi_epi##bits(a[k], a[k + (n) / 2]);       \
+    }                                                                   \
+    for (int k = 0; k < (n); k++)                                       \
+      a[k] = b_[k];                                                     \
+  }
+
+// 32 x 32 bytes
+// The unpack network transposes the 16 x 16 blocks of each lane of
+// the rows 0-15, then of the rows 16-31; permute2x128 joins them.
+__attribute__((target("avx2")))
+inline void transposeMicro32x32_avx2(uint8_t *dst, size_t ldd, const uint8_t *src, size_t lds)
+{
+  __m256i a[16], b[16];
+
+  for (int k = 0; k < 16; k++) {
+    a[k] = _mm256_loadu_si256((const __m256i *) (src + k*lds));
+    b[k] = _mm256_loadu_si256((const __m256i *) (src + (16+k)*lds));
+  }
+  UNPACK_NETWORK(a, 16, 4, 8)
+  UNPACK_NETWORK(b, 16, 4, 8)
+
+  for (int c = 0; c < 16; c++) {
+    _mm256_storeu_si256((__m256i *) (dst + c*ldd),      _mm256_permute2x128_si256(a[c], b[c], 0x20));
+    _mm256_storeu_si256((__m256i *) (dst + (16+c)*ldd), _mm256_permute2x128_si256(a[c], b[c], 0x31));
+  }
+}
+
+// 16 x 16 of 16-bit elements: same as the byte kernel, with the
+// 8 x 8 blocks of each lane
+__attribute__((target("avx2")))
+inline void transposeMicro16x16_avx2(uint16_t *dst, size_t ldd, const uint16_t *src, size_t lds)
+{
+  __m256i a[8], b[8];
+
+  for (int k = 0; k < 8; k++) {
+    a[k] = _mm256_loadu_si256((const __m256i *) (src + k*lds));
+    b[k] = _mm256_loadu_si256((const __m256i *) (src + (8+k)*lds));
+  }
+  UNPACK_NETWORK(a, 8, 3, 16)
+  UNPACK_NETWORK(b, 8, 3, 16)
+
+  for (int c = 0; c < 8; c++) {
+    _mm256_storeu_si256((__m256i *) (dst + c*ldd),     _mm256_permute2x128_si256(a[c], b[c], 0x20));
+    _mm256_storeu_si256((__m256i *) (dst + (8+c)*ldd), _mm256_permute2x128_si256(a[c], b[c], 0x31));
+  }
+}
+
+// A micro-kernel on elements of type U, for elements of type T of
+// the same size
+template <typename T, typename U, void (*F)(U *, size_t, const U *, size_t)>
+void sameSize(T *dst, size_t ldd, const T *src, size_t lds)
+{
+  F((U *) dst, ldd, (const U *) src, lds);
+}
+
+// Best micro-kernel for T up to instruction set max_isa, by the size
+// of T; types of other sizes get the scalar 8 x 8 kernel
+template <typename T>
+microKernel<T> selectMicroKernel(simd_isa max_isa)
+{
+  simd_isa isa = cpuIsa() < max_isa ? cpuIsa() : max_isa;
+  microKernel<T> mk = { ISA_SCALAR, 8, transposeMicro<T, 8> };
+
+  switch (sizeof(T)) {
+  case 1:
+    mk.dim = 32; mk.fn = transposeMicro<T, 32>;
+    if (isa >= ISA_AVX2) {
+      mk.isa = ISA_AVX2; mk.fn = sameSize<T, uint8_t, transposeMicro32x32_avx2>;
+    }
+    break;
+  case 2:
+    mk.dim = 16; mk.fn = transposeMicro<T, 16>;
+    if (isa >= ISA_AVX2) {
+      mk.isa = ISA_AVX2; mk.fn = sameSize<T, uint16_t, transposeMicro16x16_avx2>;
+    }
+    break;
+  case 4:
+    if (isa >= ISA_AVX512) {
+      mk.isa = ISA_AVX512; mk.dim = 16; mk.fn = sameSize<T, float, transposeMicro16x16_avx512>;
+    } else if (isa >= ISA_AVX2) {
+      mk.isa = ISA_AVX2;   mk.dim = 8;  mk.fn = sameSize<T, float, transposeMicro8x8_avx2>;
+    }
+    break;
+  case 8:
+    mk.dim = 4; mk.fn = transposeMicro<T, 4>;
+    if (isa >= ISA_AVX512) {
+      mk.isa = ISA_AVX512; mk.dim = 8; mk.fn = sameSize<T, double, transposeMicro8x8_avx512>;
+    } else if (isa >= ISA_AVX2) {
+      mk.isa = ISA_AVX2;   mk.fn = sameSize<T, double, transposeMicro4x4_avx2>;
+    }
+    break;
+  case 16:
+    mk.dim = 2; mk.fn = transposeMicro<T, 2>;
+    if (isa >= ISA_AVX512) {
+      mk.isa = ISA_AVX512; mk.dim = 4; mk.fn = sameSize<T, __m128d, transposeMicro4x4_avx512>;
+    } else if (isa >= ISA_AVX2) {
+      mk.isa = ISA_AVX2;   mk.fn = sameSize<T, __m128d, transposeMicro2x2_avx2>;
+    }
+    break;
+  }
+  return mk;
+}
+
+// Micro-kernel for ny x nx matrices: the best up to max_isa whose
+// blocks tile the matrix, else the scalar 8 x 8 if it does, so that
+// a matrix of a few blocks is transposed with no scalar edges; a
+// matrix of one block is then transposed whole in registers
+template <typename T>
+microKernel<T> selectMicroKernel(simd_isa max_isa, int nx, int ny)
+{
+  microKernel<T> scalar8 = { ISA_SCALAR, 8, transposeMicro<T, 8> };
+
+  for (int isa = max_isa; isa >= ISA_SCALAR; isa--) {
+    microKernel<T> mk = selectMicroKernel<T>((simd_isa) isa);
+    if (nx % mk.dim == 0 && ny % mk.dim == 0)
+      return mk;
+  }
+  if (nx % 8 == 0 && ny % 8 == 0)
+    return scalar8;
+  return selectMicroKernel<T>(max_isa);
+}
+
+#endif
@@ -0,0 +1,117 @@
+// Tuning cache of the CPU transpose
+//
+// One line per entry:
+//
+//   type nx ny max_threads tile isa threads gbps model
+//
+// where model, the last field, is the model name of the CPU and may
+// contain blanks. Entries are replaced by rewriting the file to a
+// temporary of a unique name and renaming it over the cache, under a
+// lock on <file>.lock, so that nodes sharing the cache do not drop
+// each other's entries.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "transpose_tune.h"
+
+const char *tuneDefaultFile()
+{
+  static char file[4096];
+  const char *env = getenv("TRANSPOSE_TUNE_FILE");
+  const char *home = getenv("HOME");
+
+  if (env && *env)
+    return env;
+  snprintf(file, sizeof(file), "%s/.transpose_cpu.tune", home ? home : ".");
+  return file;
+}
+
+// Parse a line of the cache; false if malformed
+static bool parseEntry(const char *line, char *type, int *nx, int *ny, int *max_threads,
+                       tuneParams *p, char *model)
+{
+  char isa[16];
+  int n = sscanf(line, "%15s %d %d %d %d %15s %d %lf %255[^\n]",
+                 type, nx, ny, max_threads, &p->tile, isa, &p->threads, &p->gbps, model);
+  if (n != 9)
+    return false;
+
+  for (int i = ISA_SCALAR; i <= ISA_AVX512; i++)
+    if (strcmp(isa, simd_isa_name[i]) == 0) {
+      p->isa = (simd_isa) i;
+      return p->tile > 0 && p->threads > 0;
+    }
+  return false;
+}
+
+bool tuneLookup(const char *file, const char *model, const char *type,
+                int nx, int ny, int max_threads, simd_isa max_isa, tuneParams *p)
+{
+  char line[512], etype[16], emodel[256];
+  int enx, eny, emax;
+  tuneParams e;
+  bool found = false;
+  FILE *fp = fopen(file, "r");
+
+  if (fp == NULL)
+    return false;
+  while (fgets(line, sizeof(line), fp))
+    if (parseEntry(line, etype, &enx, &eny, &emax, &e, emodel) &&
+        strcmp(etype, type) == 0 && enx == nx && eny == ny && emax == max_threads &&
+        strcmp(emodel, model) == 0 && e.isa <= cpuIsa() && e.isa <= max_isa) {
+      *p = e;
+      found = true;
+    }
+  fclose(fp);
+  return found;
+}
+
+bool tuneStore(const char *file, const char *model, const char *type,
+               int nx, int ny, int max_threads, const tuneParams &p)
+{
+  char line[512], etype[16], emodel[256], tmp[4200], lock[4200];
+  int enx, eny, emax, fd, lfd;
+  tuneParams e;
+  FILE *in, *out;
+
+  // the lock is advisory: without it, the store goes on unlocked
+  snprintf(lock, sizeof(lock), "%s.lock", file);
+  if ((lfd = open(lock, O_RDWR | O_CREAT, 0644)) >= 0)
+    lockf(lfd, F_LOCK, 0);
+
+  snprintf(tmp, sizeof(tmp), "%s.XXXXXX", file);
+  if ((fd = mkstemp(tmp)) < 0 || (out = fdopen(fd, "w")) == NULL) {
+    if (fd >= 0) {
+      close(fd);
+      remove(tmp);
+    }
+    if (lfd >= 0)
+      close(lfd);
+    return false;
+  }
+  fchmod(fd, 0644);
+
+  // keep the other entries
+  if ((in = fopen(file, "r")) != NULL) {
+    while (fgets(line, sizeof(line), in))
+      if (parseEntry(line, etype, &enx, &eny, &emax, &e, emodel) &&
+          !(strcmp(etype, type) == 0 && enx == nx && eny == ny && emax == max_threads &&
+            strcmp(emodel, model) == 0))
+        fputs(line, out);
+    fclose(in);
+  }
+
+  fprintf(out, "%s %d %d %d %d %s %d %.2f %s\n", type, nx, ny, max_threads,
+          p.tile, simd_isa_name[p.isa], p.threads, p.gbps, model);
+  bool ok = fclose(out) == 0 && rename(tmp, file) == 0;
+  if (!ok)
+    remove(tmp);
+  if (lfd >= 0)
+    close(lfd);
+  return ok;
+}
@@ -0,0 +1,121 @@
+// Autotuning of the blocked transpose
+//
+// The best tile depends on the cache sizes, and the best number of
+// threads on the cores and the memory bandwidth, so TILE_DIM is not
+// the best choice on every node. The tuner times transposeSimd over
+// a grid of tile sizes, micro-kernels and thread counts for a shape
+// and element type, and keeps the fastest. The winners are stored in
+// a cache file, one line per CPU model, type, shape and thread limit,
+// so a home directory shared by different nodes keeps the results of
+// each, and later runs read them back instead of searching again.
+
+#ifndef TRANSPOSE_TUNE_H
+#define TRANSPOSE_TUNE_H
+
+#include <stdio.h>
+#include <omp.h>
+
+#include "transpose_cpu.h"
+
+// Tile sizes of the search
+const int TUNE_TILES[] = { 16, 32, 64, 128, 256 };
+const int TUNE_NUM_TILES = sizeof(TUNE_TILES) / sizeof(TUNE_TILES[0]);
+
+// Time per candidate of the search
+const double TUNE_SECONDS = 0.05;
+
+// Parameters of the blocked transpose
+struct tuneParams {
+  int      tile;      // tile of the blocking
+  simd_isa isa;       // micro-kernel, whose dim is the micro-tile
+  int      threads;
+  double   gbps;      // bandwidth measured by the tuner, 0 if not tuned
+};
+
+// Default cache file: $TRANSPOSE_TUNE_FILE or ~/.transpose_cpu.tune
+const char *tuneDefaultFile();
+
+// Look up the parameters of a shape, with a micro-kernel up to
+// max_isa; false if not in the cache
+bool tuneLookup(const char *file, const char *model, const char *type,
+                int nx, int ny, int max_threads, simd_isa max_isa, tuneParams *p);
+
+// Store the parameters of a shape, replacing its previous entry
+bool tuneStore(const char *file, const char *model, const char *type,
+               int nx, int ny, int max_threads, const tuneParams &p);
+
+// Parameters used before tuning: the fixed tile, the best micro-kernel
+// up to max_isa and every thread
+inline tuneParams tuneDefaults(simd_isa max_isa)
+{
+  tuneParams p = { TILE_DIM, cpuIsa() < max_isa ? cpuIsa() : max_isa, omp_get_max_threads(), 0 };
+  return p;
+}
+
+// blocked transpose with tuned parameters
+template <typename T>
+void transposeTuned(T *odata, const T *idata, int nx, int ny, const tuneParams &p)
+{
+  int saved = omp_get_max_threads();
+
+  omp_set_num_threads(p.threads);
+  transposeSimd(odata, idata, nx, ny, selectMicroKernel<T>(p.isa), p.tile);
+  omp_set_num_threads(saved);
+}
+
+// Bandwidth of transposeTuned with p, over at least TUNE_SECONDS
+template <typename T>
+double tuneTime(T *odata, const T *idata, int nx, int ny, const tuneParams &p)
+{
+  int reps = 0;
+
+  // warm up
+  transposeTuned(odata, idata, nx, ny, p);
+  double start = omp_get_wtime(), elapsed;
+  do {
+    transposeTuned(odata, idata, nx, ny, p);
+    reps++;
+    elapsed = omp_get_wtime() - start;
+  } while (elapsed < TUNE_SECONDS);
+
+  return 2.0 * nx * ny * sizeof(T) * 1e-9 * reps / elapsed;
+}
+
+// Search the tiles, micro-kernels up to max_isa and thread counts
+// (powers of two up to max_threads, and max_threads) for the fastest;
+// verbose prints a line per candidate
+template <typename T>
+tuneParams autotune(T *odata, const T *idata, int nx, int ny, int max_threads,
+                    simd_isa max_isa, bool verbose)
+{
+  tuneParams best = tuneDefaults(max_isa);
+  best.gbps = 0;
+
+  if (verbose)
+    printf("%8s %16s %8s %12s\n", "tile", "micro-kernel", "threads", "GB/s");
+  for (int isa = best.isa; isa >= ISA_SCALAR; isa--) {
+    microKernel<T> mk = selectMicroKernel<T>((simd_isa) isa);
+    if (mk.isa != isa)
+      continue;     // same kernel as a higher instruction set
+
+    for (int t = 0; t < TUNE_NUM_TILES; t++) {
+      if (TUNE_TILES[t] % mk.dim)
+        continue;
+
+      for (int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        tuneParams p = { TUNE_TILES[t], (simd_isa) isa, threads, 0 };
+        p.gbps = tuneTime(odata, idata, nx, ny, p);
+        if (verbose)
+          printf("%8d %8s %2d x %-2d %8d %12.2f\n",
+                 p.tile, simd_isa_name[isa], mk.dim, mk.dim, p.threads, p.gbps);
+        if (p.gbps > best.gbps)
+          best = p;
+        if (threads == max_threads)
+          break;
+      }
+    }
+  }
+  return best;
+}
+
+#endif
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 
 // Convenience function for checking CUDA runtime API results
@@ -87,9 +88,10 @@ __global__ void transposeNaive(float *odata, const float *idata)
   int x = blockIdx.x * TILE_DIM + threadIdx.x;
   int y = blockIdx.y * TILE_DIM + threadIdx.y;
   int width = gridDim.x * TILE_DIM;
+  int height = gridDim.y * TILE_DIM;
 
   for (int j = 0; j < TILE_DIM; j+= BLOCK_ROWS)
-    odata[x*width + (y+j)] = idata[(y+j)*width + x];
+    odata[x*height + (y+j)] = idata[(y+j)*width + x];
 }
 
 // coalesced transpose
@@ -102,6 +104,7 @@ __global__ void transposeCoalesced(float *odata, const float *idata)
   int x = blockIdx.x * TILE_DIM + threadIdx.x;
   int y = blockIdx.y * TILE_DIM + threadIdx.y;
   int width = gridDim.x * TILE_DIM;
+  int height = gridDim.y * TILE_DIM;
 
   for (int j = 0; j < TILE_DIM; j += BLOCK_ROWS)
      tile[threadIdx.y+j][threadIdx.x] = idata[(y+j)*width + x];
@@ -112,7 +115,7 @@ __global__ void transposeCoalesced(float *odata, const float *idata)
   y = blockIdx.x * TILE_DIM + threadIdx.y;
 
   for (int j = 0; j < TILE_DIM; j += BLOCK_ROWS)
-     odata[(y+j)*width + x] = tile[threadIdx.x][threadIdx.y + j];
+     odata[(y+j)*height + x] = tile[threadIdx.x][threadIdx.y + j];
 }
    
 
@@ -126,6 +129,7 @@ __global__ void transposeNoBankConflicts(float *odata, const float *idata)
   int x = blockIdx.x * TILE_DIM + threadIdx.x;
   int y = blockIdx.y * TILE_DIM + threadIdx.y;
   int width = gridDim.x * TILE_DIM;
+  int height = gridDim.y * TILE_DIM;
 
   for (int j = 0; j < TILE_DIM; j += BLOCK_ROWS)
      tile[threadIdx.y+j][threadIdx.x] = idata[(y+j)*width + x];
@@ -136,20 +140,26 @@ __global__ void transposeNoBankConflicts(float *odata, const float *idata)
   y = blockIdx.x * TILE_DIM + threadIdx.y;
 
   for (int j = 0; j < TILE_DIM; j += BLOCK_ROWS)
-     odata[(y+j)*width + x] = tile[threadIdx.x][threadIdx.y + j];
+     odata[(y+j)*height + x] = tile[threadIdx.x][threadIdx.y + j];
 }
 
 int main(int argc, char **argv)
 {
-  const int nx = 1024;
-  const int ny = 1024;
-  const int mem_size = nx*ny*sizeof(float);
+  // transpose [devId], as before, or transpose nx ny [devId]
+  int nx = 1024;
+  int ny = 1024;
+  int devId = 0;
+  if (argc == 2) devId = atoi(argv[1]);
+  if (argc > 2) {
+    nx = atoi(argv[1]);
+    ny = atoi(argv[2]);
+  }
+  const size_t mem_size = (size_t)nx*ny*sizeof(float);
 
   dim3 dimGrid(nx/TILE_DIM, ny/TILE_DIM, 1);
   dim3 dimBlock(TILE_DIM, BLOCK_ROWS, 1);
 
-  int devId = 0;
-  if (argc > 1) devId = atoi(argv[1]);
+  if (argc > 3) devId = atoi(argv[3]);
 
   cudaDeviceProp prop;
   checkCuda( cudaGetDeviceProperties(&prop, devId));
@@ -172,7 +182,7 @@ int main(int argc, char **argv)
   checkCuda( cudaMalloc(&d_tdata, mem_size) );
 
   // check parameters and calculate execution configuration
-  if (nx % TILE_DIM || ny % TILE_DIM) {
+  if (nx <= 0 || ny <= 0 || nx % TILE_DIM || ny % TILE_DIM) {
     printf("nx and ny must be a multiple of TILE_DIM\n");
     goto error_exit;
   }
@@ -190,7 +200,7 @@ int main(int argc, char **argv)
   // correct result for error checking
   for (int j = 0; j < ny; j++)
     for (int i = 0; i < nx; i++)
-      gold[j*nx + i] = h_idata[i*nx + j];
+      gold[i*ny + j] = h_idata[j*nx + i];
   
   // device
   checkCuda( cudaMemcpy(d_idata, h_idata, mem_size, cudaMemcpyHostToDevice) );
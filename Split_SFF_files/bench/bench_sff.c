@@ -0,0 +1,656 @@
+/*
+
+  Microbenchmarks for the primitives of sff.c and match.c:
+  reading and writing read headers and read data, extracting
+  the bases of a read, and matching adapters.
+
+  The reads are generated in memory (random bases, quality
+  values and flowgrams) for several read lengths and numbers
+  of adapter patterns, and written to an in-memory SFF stream
+  with write_sff_read_header() and write_sff_read_data(), so
+  the readers see records in the file format.
+
+  Each benchmark runs passes over the reads until a minimum
+  time has elapsed, and reports the mean time per read and
+  the bytes processed per cycle of the time stamp counter.
+  The results can be saved to a file and compared to a saved
+  baseline.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  #define HAVE_TSC 1
+#endif
+
+#include "sff.h"
+#include "match.h"
+
+
+
+/** CONSTANTS **/
+
+#define BENCH_NREADS        2048
+#define BENCH_NFLOWS        800
+#define BENCH_KEY_LEN       4
+#define BENCH_PATTERN_LEN   10
+#define BENCH_MAX_RESULTS   64
+
+// Default min time per benchmark (s) and regression threshold (%)
+#define BENCH_MIN_TIME      0.25
+#define BENCH_THRESHOLD     10.0
+
+static const int bench_read_len[]  = { 100, 200, 400 };
+static const int bench_npatterns[] = { 1, 16, 96 };
+
+#define NELEMS(a)  ( (int) (sizeof(a) / sizeof((a)[0])) )
+
+
+
+/** TYPES **/
+
+//
+// The reads of one read length, in memory and as SFF records
+//
+typedef struct {
+    int               len;
+    sff_read_header   rh[BENCH_NREADS];
+    sff_read_data     rd[BENCH_NREADS];
+
+    char            * headers;       /* the read headers, back to back   */
+    size_t            headers_size;
+    char            * data;          /* the read data sections           */
+    size_t            data_size;
+
+    int               npatterns;
+    char           ** patterns;
+} bench_reads;
+
+
+typedef struct {
+    char    name[64];
+    double  ns_per_read;
+    double  bytes_per_cycle;         /* 0 if there is no cycle counter */
+} bench_result;
+
+
+// A benchmark makes one pass over the reads and returns the bytes processed
+typedef size_t (* bench_fn)(bench_reads * br);
+
+
+
+/** GLOBALS **/
+
+static double        min_time  = BENCH_MIN_TIME;
+static double        threshold = BENCH_THRESHOLD;
+static char        * filter    = NULL;
+
+static bench_result  results[BENCH_MAX_RESULTS];
+static int           nresults  = 0;
+
+static sff_common_header bench_ch;
+
+static uint64_t      rng_state = 0x853c49e6748fea9bULL;
+
+
+
+/** FUNCTIONS **/
+
+
+static uint32_t
+rng(void)
+{
+    rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t) (rng_state >> 33);
+}
+
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static uint64_t
+now_cycles(void)
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+
+
+//
+// Generate BENCH_NREADS reads of length len, and write them as
+// SFF records: the headers to one buffer and the data sections
+// to another, so each can be read back to back
+//
+static void
+generate_reads(bench_reads * br, int len, char ** patterns, int npatterns)
+{
+
+  static const char acgt[] = "ACGT";
+  FILE * fp;
+  int k, j;
+
+  br->len       = len;
+  br->patterns  = patterns;
+  br->npatterns = npatterns;
+
+  for (k = 0; k < BENCH_NREADS; k++) {
+
+    sff_read_header * rh = &(br->rh[k]);
+    sff_read_data   * rd = &(br->rd[k]);
+
+    //
+    // 1. Read header
+    //
+    rh->name = malloc(16);
+    snprintf(rh->name, 16, "BENCH%09d", k);
+    rh->name_len           = strlen(rh->name);
+    rh->header_len         = (SFF_READ_HEADER_FIXED + rh->name_len + 7) & ~7;
+    rh->nbases             = len;
+    rh->clip_qual_left     = BENCH_KEY_LEN + 1;
+    rh->clip_qual_right    = len;
+    rh->clip_adapter_left  = 0;
+    rh->clip_adapter_right = 0;
+
+
+    //
+    // 2. Read data; read k has pattern k % npatterns after
+    //    the key, so that the matchers find hits
+    //
+    rd->flowgram   = malloc( BENCH_NFLOWS * sizeof(uint16_t) );
+    rd->flow_index = malloc( len );
+    rd->bases      = malloc( len + 1 );
+    rd->quality    = malloc( len );
+    rd->raw        = NULL;
+
+    for (j = 0; j < BENCH_NFLOWS; j++) {
+      rd->flowgram[j] = rng() % 1000;
+    }
+    for (j = 0; j < len; j++) {
+      rd->flow_index[j] = rng() % 4;
+      rd->bases[j]      = acgt[rng() % 4];
+      rd->quality[j]    = 10 + rng() % 31;
+    }
+    if ( npatterns > 0 && k % 2 == 0 ) {
+      memcpy(rd->bases + BENCH_KEY_LEN + 6, patterns[(k / 2) % npatterns], BENCH_PATTERN_LEN);
+    }
+    rd->bases[len] = '\0';
+  }
+
+
+  //
+  // 3. The records in the file format
+  //
+  fp = open_memstream(&(br->headers), &(br->headers_size));
+  for (k = 0; k < BENCH_NREADS; k++) {
+    write_sff_read_header(fp, &(br->rh[k]));
+  }
+  fclose(fp);
+
+  fp = open_memstream(&(br->data), &(br->data_size));
+  for (k = 0; k < BENCH_NREADS; k++) {
+    write_sff_read_data(fp, &(br->rd[k]), BENCH_NFLOWS, len, k);
+  }
+  fclose(fp);
+
+} // generate_reads()
+
+
+
+static void
+free_reads(bench_reads * br)
+{
+
+  int k;
+
+  for (k = 0; k < BENCH_NREADS; k++) {
+    free_sff_read_header(&(br->rh[k]));
+    free_sff_read_data(&(br->rd[k]));
+  }
+  free(br->headers);
+  free(br->data);
+
+} // free_reads()
+
+
+
+/** BENCHMARKS **/
+
+
+static size_t
+bench_read_header(bench_reads * br)
+{
+
+  sff_read_header rh;
+  FILE * fp = fmemopen(br->headers, br->headers_size, "r");
+  int k;
+
+  for (k = 0; k < BENCH_NREADS; k++) {
+    read_sff_read_header(fp, &rh);
+    free_sff_read_header(&rh);
+  }
+  fclose(fp);
+
+  return br->headers_size;
+
+} // bench_read_header()
+
+
+
+static size_t
+bench_read_data(bench_reads * br)
+{
+
+  sff_read_data rd;
+  FILE * fp = fmemopen(br->data, br->data_size, "r");
+  int k;
+
+  for (k = 0; k < BENCH_NREADS; k++) {
+    read_sff_read_data(fp, &rd, BENCH_NFLOWS, br->len, k);
+    free_sff_read_data(&rd);
+  }
+  fclose(fp);
+
+  return br->data_size;
+
+} // bench_read_data()
+
+
+
+static size_t
+bench_read_data_lazy(bench_reads * br)
+{
+
+  sff_read_data rd;
+  FILE * fp = fmemopen(br->data, br->data_size, "r");
+  int k;
+
+  for (k = 0; k < BENCH_NREADS; k++) {
+    read_sff_read_data_lazy(fp, &rd, BENCH_NFLOWS, br->len, k);
+    free_sff_read_data(&rd);
+  }
+  fclose(fp);
+
+  return br->data_size;
+
+} // bench_read_data_lazy()
+
+
+
+static size_t
+bench_write_data(bench_reads * br)
+{
+
+  static char * buf = NULL;
+  static size_t buf_size = 0;
+  FILE * fp;
+  int k;
+
+  if ( buf_size < br->data_size ) {
+    free(buf);
+    buf_size = br->data_size;
+    buf = malloc(buf_size);
+  }
+
+  fp = fmemopen(buf, buf_size, "w");
+  for (k = 0; k < BENCH_NREADS; k++) {
+    write_sff_read_data(fp, &(br->rd[k]), BENCH_NFLOWS, br->len, k);
+  }
+  fclose(fp);
+
+  return br->data_size;
+
+} // bench_write_data()
+
+
+
+static size_t
+bench_get_read_bases(bench_reads * br)
+{
+
+  size_t bytes = 0;
+  int k;
+
+  for (k = 0; k < BENCH_NREADS; k++) {
+    char * bases = get_read_bases(&(br->rd[k]), BENCH_KEY_LEN, br->len);
+    bytes += br->len - BENCH_KEY_LEN;
+    free(bases);
+  }
+
+  return bytes;
+
+} // bench_get_read_bases()
+
+
+
+//
+// The generic matcher: every pattern against the bases after the key
+//
+static size_t
+bench_match(bench_reads * br)
+{
+
+  size_t bytes = 0;
+  volatile int hits = 0;
+  int k, p;
+
+  for (k = 0; k < BENCH_NREADS; k++) {
+    char * text = br->rd[k].bases + BENCH_KEY_LEN;
+    for (p = 0; p < br->npatterns; p++) {
+      hits += ( match(text, br->patterns[p]) >= 0 );
+      bytes += br->len - BENCH_KEY_LEN;
+    }
+  }
+
+  return bytes;
+
+} // bench_match()
+
+
+
+//
+// The matcher picked by get_patterns() (packed for the
+// 10-base patterns), through match_read_pattern()
+//
+static size_t
+bench_match_read_pattern(bench_reads * br)
+{
+
+  sff_read_header rh_trim;
+  size_t bytes = 0;
+  volatile int hits = 0;
+  int k, p, pos;
+
+  for (k = 0; k < BENCH_NREADS; k++) {
+    for (p = 0; p < br->npatterns; p++) {
+      hits += match_read_pattern(&bench_ch, &(br->rh[k]), &(br->rd[k]), br->patterns, p,
+				 k, 0, NULL, &rh_trim, &pos) == READ_MATCH;
+      bytes += br->len - BENCH_KEY_LEN;
+    }
+  }
+
+  return bytes;
+
+} // bench_match_read_pattern()
+
+
+
+//
+// Run fn over the reads for at least min_time seconds, and
+// record the time per read and the bytes per cycle
+//
+static void
+run_bench(const char * name, bench_fn fn, bench_reads * br)
+{
+
+  uint64_t t0, t1, c0, c1;
+  size_t   bytes = 0;
+  long     npasses = 0;
+
+  if ( filter != NULL && strstr(name, filter) == NULL ) {
+    return;
+  }
+  if ( nresults == BENCH_MAX_RESULTS ) {
+    fprintf(stderr, "[err] Too many benchmarks\n");
+    exit(1);
+  }
+
+  // Warm up the caches and the allocator
+  fn(br);
+
+  t0 = now_ns();
+  c0 = now_cycles();
+  do {
+    bytes += fn(br);
+    npasses++;
+    t1 = now_ns();
+  } while ( t1 - t0 < min_time * 1e9 );
+  c1 = now_cycles();
+
+  bench_result * r = &results[nresults++];
+  snprintf(r->name, sizeof(r->name), "%s", name);
+  r->ns_per_read     = (double) (t1 - t0) / ( (double) npasses * BENCH_NREADS );
+  r->bytes_per_cycle = ( c1 > c0 ) ? (double) bytes / (c1 - c0) : 0.0;
+
+  printf("%-36s %12.1f %12.3f\n", r->name, r->ns_per_read, r->bytes_per_cycle);
+  fflush(stdout);
+
+} // run_bench()
+
+
+
+//
+// Save the results, one benchmark per line
+//
+static void
+save_results(char * file)
+{
+
+  FILE * fp = fopen(file, "w");
+  int i;
+
+  if ( fp == NULL ) {
+    fprintf(stderr, "[err] Could not open file '%s' for writing the results.\n", file);
+    exit(1);
+  }
+
+  for (i = 0; i < nresults; i++) {
+    fprintf(fp, "%s %.3f %.5f\n", results[i].name, results[i].ns_per_read, results[i].bytes_per_cycle);
+  }
+  fclose(fp);
+
+} // save_results()
+
+
+
+//
+// Compare the results with the baseline saved in file.
+// Return the number of benchmarks slower than the baseline
+// by more than threshold percent.
+//
+static int
+compare_results(char * file)
+{
+
+  FILE * fp = fopen(file, "r");
+  char   name[64];
+  double ns, bpc;
+  int    i, nslower = 0;
+
+  if ( fp == NULL ) {
+    fprintf(stderr, "[err] Could not open the baseline file '%s'.\n", file);
+    exit(1);
+  }
+
+  printf("\nComparison with the baseline %s (threshold %.1f%%):\n", file, threshold);
+  printf("%-36s %12s %12s %9s\n", "benchmark", "base ns/read", "ns/read", "change");
+
+  while ( fscanf(fp, "%63s %lf %lf", name, &ns, &bpc) == 3 ) {
+    for (i = 0; i < nresults; i++) {
+      if ( strcmp(results[i].name, name) == 0 ) {
+	break;
+      }
+    }
+    if ( i == nresults ) {
+      continue;
+    }
+
+    double change = 100.0 * (results[i].ns_per_read - ns) / ns;
+    int    slower = change > threshold;
+
+    printf("%-36s %12.1f %12.1f %+8.1f%%%s\n", name, ns, results[i].ns_per_read, change,
+	   slower ? "  SLOWER" : ( change < -threshold ? "  faster" : "" ));
+    nslower += slower;
+  }
+  fclose(fp);
+
+  return nslower;
+
+} // compare_results()
+
+
+
+static void
+usage(char * prg)
+{
+
+  fprintf(stdout, "Usage: %s [options]\n", prg);
+  fprintf(stdout, "\t%-24s%s\n", "-f, --filter <s>",     "Run only the benchmarks whose name contains s");
+  fprintf(stdout, "\t%-24s%s %.2f\n", "-t, --min-time <s>", "Min time per benchmark, in seconds. Default:", BENCH_MIN_TIME);
+  fprintf(stdout, "\t%-24s%s\n", "-s, --save <file>",    "Save the results as a baseline");
+  fprintf(stdout, "\t%-24s%s\n", "-c, --compare <file>", "Compare the results with a saved baseline; exit with 2 if a benchmark is slower");
+  fprintf(stdout, "\t%-24s%s %.1f\n", "-p, --threshold <pct>", "Slowdown reported as a regression. Default:", BENCH_THRESHOLD);
+
+} // usage()
+
+
+
+int main(int argc, char *argv[])
+{
+
+  char * save_file    = NULL;
+  char * compare_file = NULL;
+  char   name[64];
+  int    c, l, n, p;
+
+  static struct option long_options[] = {
+      { "filter",    required_argument, NULL, 'f' },
+      { "min-time",  required_argument, NULL, 't' },
+      { "save",      required_argument, NULL, 's' },
+      { "compare",   required_argument, NULL, 'c' },
+      { "threshold", required_argument, NULL, 'p' },
+      { "help",      no_argument,       NULL, 'h' },
+      { NULL,        0,                 NULL,  0  }
+  };
+
+  while( (c = getopt_long(argc, argv, "f:t:s:c:p:h", long_options, NULL)) != -1 ) {
+      switch(c) {
+          case 'f':
+              filter = optarg;
+              break;
+          case 't':
+              min_time = atof(optarg);
+              break;
+          case 's':
+              save_file = optarg;
+              break;
+          case 'c':
+              compare_file = optarg;
+              break;
+          case 'p':
+              threshold = atof(optarg);
+              break;
+          case 'h':
+              usage(argv[0]);
+              exit(0);
+          default:
+              usage(argv[0]);
+              exit(1);
+      }
+  }
+
+
+  //
+  // 1. The common header seen by match_read_pattern(),
+  //    and the adapter patterns
+  //
+  memset(&bench_ch, 0, sizeof(bench_ch));
+  bench_ch.key_len  = BENCH_KEY_LEN;
+  bench_ch.flow_len = BENCH_NFLOWS;
+
+  int    max_patterns = bench_npatterns[NELEMS(bench_npatterns) - 1];
+  char ** patterns = malloc( max_patterns * sizeof(char *) );
+  for (p = 0; p < max_patterns; p++) {
+    patterns[p] = malloc(BENCH_PATTERN_LEN + 1);
+    for (c = 0; c < BENCH_PATTERN_LEN; c++) {
+      patterns[p][c] = "ACGT"[rng() % 4];
+    }
+    patterns[p][BENCH_PATTERN_LEN] = '\0';
+  }
+
+  printf("%-36s %12s %12s\n", "benchmark", "ns/read", "bytes/cycle");
+
+
+  //
+  // 2. Run the benchmarks for each read length, and the
+  //    matchers for each number of patterns
+  //
+  for (l = 0; l < NELEMS(bench_read_len); l++) {
+
+    bench_reads * br = calloc(1, sizeof(bench_reads));
+    int len = bench_read_len[l];
+
+    generate_reads(br, len, patterns, max_patterns);
+
+    snprintf(name, sizeof(name), "read_header/len=%d", len);
+    run_bench(name, bench_read_header, br);
+
+    snprintf(name, sizeof(name), "read_data/len=%d", len);
+    run_bench(name, bench_read_data, br);
+
+    snprintf(name, sizeof(name), "read_data_lazy/len=%d", len);
+    run_bench(name, bench_read_data_lazy, br);
+
+    snprintf(name, sizeof(name), "write_data/len=%d", len);
+    run_bench(name, bench_write_data, br);
+
+    snprintf(name, sizeof(name), "get_read_bases/len=%d", len);
+    run_bench(name, bench_get_read_bases, br);
+
+    for (n = 0; n < NELEMS(bench_npatterns); n++) {
+
+      br->npatterns = bench_npatterns[n];
+      select_matcher(patterns, br->npatterns);
+
+      snprintf(name, sizeof(name), "match/len=%d/pat=%d", len, br->npatterns);
+      run_bench(name, bench_match, br);
+
+      snprintf(name, sizeof(name), "match_read_pattern/len=%d/pat=%d", len, br->npatterns);
+      run_bench(name, bench_match_read_pattern, br);
+    }
+
+    free_reads(br);
+    free(br);
+  }
+
+
+  //
+  // 3. Save and compare the results
+  //
+  if ( save_file != NULL ) {
+    save_results(save_file);
+  }
+
+  int nslower = 0;
+  if ( compare_file != NULL ) {
+    nslower = compare_results(compare_file);
+  }
+
+  for (p = 0; p < max_patterns; p++) {
+    free(patterns[p]);
+  }
+  free(patterns);
+
+  return nslower > 0 ? 2 : 0;
+
+} // main()
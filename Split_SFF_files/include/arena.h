@@ -0,0 +1,47 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+
+/* Size of the blocks of an arena; larger requests get a block of their own */
+#define ARENA_BLOCK_SIZE  (1 << 20)
+
+/* Alignment of the blocks bound to a NUMA node */
+#define ARENA_PAGE_SIZE   4096
+
+/* Alignment of the allocations */
+#define ARENA_ALIGN       16
+
+
+typedef struct sff_arena_block {
+    struct sff_arena_block * next;
+    size_t                   size;
+    size_t                   used;
+    char                   * data;
+} sff_arena_block;
+
+
+/*
+ * A bump allocator: allocations are carved out of a list 
+ * of blocks and are all released at once by arena_reset(), 
+ * which keeps the blocks for reuse
+ */
+typedef struct {
+    sff_arena_block * head;
+    sff_arena_block * cur;
+
+    /* Optional: bind the new blocks to a NUMA node */
+    int               node;
+    void           (* bind)(void * p, size_t len, int node);
+} sff_arena;
+
+
+void   arena_init(sff_arena * a);
+void * arena_alloc(sff_arena * a, size_t n);
+void   arena_reset(sff_arena * a);
+void   arena_set_node(sff_arena * a, int node, void (* bind)(void * p, size_t len, int node));
+size_t arena_bytes(sff_arena * a);
+void   arena_free(sff_arena * a);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _BGZF_H_
+#define _BGZF_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "sff.h"
+#include "reorder.h"
+#include "perf.h"
+#include "trace.h"
+#include "log.h"
+
+
+/* Max uncompressed bytes per block, as in the BGZF of SAM/BAM */
+#define BGZF_BLOCK_SIZE     0xff00
+
+/* Max size of a compressed block, gzip header and footer included */
+#define BGZF_MAX_BLOCK      0x10000
+
+#define BGZF_HEADER_SIZE    18
+#define BGZF_FOOTER_SIZE    8
+
+#define BGZF_DEFAULT_LEVEL  6
+
+/* Blocks queued for compression before the writer compresses inline */
+#define BGZF_MAX_PENDING    256
+
+/* Suffixes of the compressed split and of its block index */
+#define BGZF_SUFFIX         ".gz"
+#define BGZF_INDEX_SUFFIX   ".gzi"
+
+
+/*
+ * A block of uncompressed data, and its compressed form 
+ * once a compression task has processed it
+ */
+typedef struct bgzf_block {
+    uint64_t             seq;       /* 0 for the header block */
+    off_t                uoffset;   /* offset in the uncompressed stream */
+    char               * data;
+    size_t               len;
+    char               * cdata;
+    size_t               clen;
+    struct bgzf_block  * next;      /* compressed, waiting to be written */
+} bgzf_block;
+
+
+/*
+ * A split written as a sequence of independently 
+ * decompressible gzip blocks. The blocks are compressed 
+ * by OpenMP tasks, so they run on the threads of the team 
+ * that does the matching, and are written to the file in 
+ * order by whichever task completes the next block.
+ */
+typedef struct {
+    char        * file_name;
+    FILE        * fp;           /* the compressed file */
+    int           level;
+
+    char        * buf;          /* uncompressed bytes of the current block */
+    size_t        len;
+    uint64_t      next_seq;     /* seq of the current block */
+    off_t         uoffset;      /* uncompressed offset of the current block */
+
+    omp_lock_t    lock;         /* protects the fields below */
+    uint64_t      write_seq;    /* seq of the next block to write */
+    bgzf_block  * done;         /* compressed blocks, sorted by seq */
+    off_t         coffset;      /* compressed bytes written */
+
+    uint64_t      nblocks;      /* block index: offsets of each block */
+    uint64_t      index_cap;
+    uint64_t    * index;        /* pairs (coffset, uoffset) */
+
+    char        * hdr;          /* the header block, kept to rewrite it */
+    size_t        hdr_len;
+    int           hdr_rewrite;  /* writes go to hdr after a seek to 0 */
+    size_t        hdr_pos;
+} bgzf_file;
+
+
+FILE * bgzf_open_sff(char * file_name, sff_common_header * ch, int level);
+
+size_t bgzf_deflate_block(char * cdata, char * data, size_t len, int level);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _CENSUS_H_
+#define _CENSUS_H_
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "sff.h"
+#include "log.h"
+
+
+/* Sampling modes of the census */
+#define CENSUS_MODE_STRIDE   0   /* strided seeks, resync on record boundaries */
+#define CENSUS_MODE_INDEX    1   /* uniform sample through the read index      */
+
+/* Consecutive reads sampled after each strided seek */
+#define CENSUS_BLOCK_READS   32
+
+/* Hit positions beyond this go to the last histogram bin */
+#define CENSUS_MAX_POS       63
+
+
+/*
+ * Counts collected from the sampled reads
+ */
+typedef struct {
+    uint64_t    nsampled;
+    uint64_t    nunmatched;
+    uint64_t  * hits;        /* hits[pat_idx]                                 */
+    uint64_t  * pos_hist;    /* pos_hist[pat_idx * (CENSUS_MAX_POS+1) + pos]  */
+} census_counts;
+
+
+void census_sff(char   * sff_file, 
+                char  ** patterns, 
+                int      num_patterns, 
+                double   fraction, 
+                int      mode, 
+                int      opt_no_clipping);
+
+#endif
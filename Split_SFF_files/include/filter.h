@@ -0,0 +1,38 @@
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include "sff.h"
+#include "log.h"
+
+
+/*
+ * Predicates that a read must pass before it is matched 
+ * against the adapters. The predicates are evaluated over 
+ * the whole read, i.e., ignoring the clip fields.
+ */
+typedef struct {
+    int  min_length;        /* min number of bases; 0 disables                  */
+    int  min_mean_qual;     /* min mean quality of the bases; 0 disables        */
+    int  max_homopolymer;   /* max length of a run of the same base; 0 disables */
+} sff_filter_options;
+
+
+/* Outcome of filter_read(): the first predicate that rejects the read */
+#define FILTER_PASS          0
+#define FILTER_LENGTH        1
+#define FILTER_QUALITY       2
+#define FILTER_HOMOPOLYMER   3
+#define FILTER_NUM           4
+
+
+int filter_enabled(sff_filter_options * opt);
+
+uint64_t filter_quality_sum(uint8_t * quality, uint32_t n);
+
+uint32_t filter_longest_homopolymer(char * bases, uint32_t n);
+
+int filter_read(sff_filter_options * opt, 
+                sff_read_header    * rh, 
+                sff_read_data      * rd);
+
+#endif
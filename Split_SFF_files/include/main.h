@@ -4,8 +4,19 @@
 
 #include "match.h"
 #include "sff.h"
+#include "reorder.h"
+#include "census.h"
+#include "filter.h"
+#include "bgzf.h"
+#include "numa_split.h"
+#include "perf.h"
+#include "trace.h"
 #include "log.h"
 
+#ifdef USE_MPI
+#include "mpi_split.h"
+#endif
+
 
 /* DEFINES */
 #define VERSION                      "1.0.0"
@@ -17,6 +28,20 @@
 
 #define MAX_NUM_ADAPTERS 256
 
+#define READ_CHUNK_SIZE          1024
+#define DEFAULT_REORDER_WINDOW   16384
+
+/* Codes of the long options that have no short form */
+#define OPT_CENSUS_MODE          1000
+#define OPT_COMPRESS_LEVEL       1001
+#define OPT_FILTER_LENGTH        1002
+#define OPT_FILTER_QUAL          1003
+#define OPT_FILTER_HOMOPOLYMER   1004
+#define OPT_NUMA                 1005
+#define OPT_PERF                 1006
+#define OPT_TRACE                1007
+#define OPT_TRACE_EVENTS         1008
+
 
 void sig_handler(int signo);
 
@@ -29,6 +54,8 @@ void process_options(int argc,
 
 void split_sff_using_adapters(char *sff_file);
 
+void census_sff_using_adapters(char *sff_file);
+
 
 void finalize_file_write( 
 			  int pat_idx
@@ -37,5 +64,16 @@ void finalize_file_write(
 
 void init_split_file_arrays( int num_patterns );
 
+void print_split_summary(void);
+
+
+sff_read_chunk * read_chunk ( FILE * sff_fp, uint32_t first_read, uint32_t n, off_t data_end, off_t * data_pos, int node );
+
+void classify_chunk ( sff_read_chunk * chunk );
+
+void emit_chunk ( sff_read_chunk * chunk );
+
+void emit_chunk_unordered ( sff_read_chunk * chunk );
+
 
 #endif
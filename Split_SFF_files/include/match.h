@@ -2,27 +2,67 @@
 #define _MATCH_H_
 
 #include "sff.h"
+#include "trim.h"
 #include "log.h"
 
 
 
 
-void match_read_pattern (	  
+/* Result of matching a read against a pattern */
+#define READ_NO_MATCH   0
+#define READ_MATCH      1
+#define READ_TOO_SHORT  2
+
+
+/* Longest pattern that can be packed in a 32-bit word, 2 bits per base */
+#define MATCH_MAX_PACKED_LEN  16
+
+
+/*
+ * The matcher that get_patterns() picks for the patterns: when 
+ * all the patterns have the same length and that length has a 
+ * specialized kernel, the patterns are packed in a word each 
+ * and the kernel scans the bases of a read for the packed word. 
+ * Otherwise, kernel is NULL and match() is used.
+ */
+typedef struct {
+    int          len;      /* length of the patterns, 0 if not all equal */
+    const char * name;     /* of the kernel, for the log                  */
+    int       (* kernel)(const char * text, int text_len, uint32_t packed);
+    uint32_t   * packed;   /* the patterns, 2 bits per base               */
+} pattern_matcher;
+
+extern pattern_matcher matcher;
+
+
+int match_read_pattern (	  
+	    sff_common_header * ch, 
+	    sff_read_header   * rh, 
+	    sff_read_data     * rd, 
+	    char             ** patterns, 
+	    int                 pat_idx, 
+	    uint32_t            read_num, 
+	    int                 opt_no_clipping, 
+	    sff_trim_options  * trim, 
+	    sff_read_header   * rh_trim, 
+	    int               * match_pos
+				  );
+
+void write_split_read (	  
 	    sff_common_header * ch, 
 	    sff_read_header   * rh, 
 	    sff_read_data     * rd, 
-	    char              * pattern, 
             int                 pat_idx, 
-	    FILE              * sff_fp, 
-            FILE             ** sff_split_fp,
+            FILE             ** sff_split_fp, 
 	    uint32_t          * nreads_split_file, 
 	    uint32_t            read_num, 
-	    int                 opt_no_clipping, 
 	    int                 dry_run
 				  );
 
 int     match(char text[], char pattern[]);
 
+void    select_matcher(char ** patterns, int num_patterns);
+
 int get_patterns(char * file_name,  char *** ptr); 
 
 char * get_adapter ( char * line );
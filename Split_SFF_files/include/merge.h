@@ -0,0 +1,44 @@
+#ifndef _MERGE_H_
+#define _MERGE_H_
+
+
+#include "sff.h"
+#include "log.h"
+
+
+/* DEFINES */
+#define MERGE_VERSION     "1.0.0"
+#define MERGE_PRG_NAME    "merge_sff"
+
+#define MAX_NUM_INPUTS    4096
+
+/* Bytes copied per call when falling back to read()/write() */
+#define MERGE_COPY_BUF    (4 << 20)
+
+
+/*
+ * An input SFF file: its common header and the 
+ * byte range [data_start, data_end) of its reads
+ */
+typedef struct {
+    char              * file_name;
+    FILE              * fp;
+    sff_common_header   ch;
+    off_t               data_start;
+    off_t               data_end;
+} merge_input;
+
+
+void merge_help_message(void);
+
+void open_merge_input(merge_input * in, char * file_name);
+
+void check_compatible_headers(merge_input * ref, merge_input * in);
+
+void check_output_file(char * out_file, merge_input * inputs, int num_inputs);
+
+void remove_partial_output(void);
+
+void copy_file_region(int fd_in, off_t off_in, int fd_out, off_t off_out, off_t len);
+
+#endif
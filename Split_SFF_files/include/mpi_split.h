@@ -0,0 +1,48 @@
+#ifndef _MPI_SPLIT_H_
+#define _MPI_SPLIT_H_
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <mpi.h>
+
+#include "sff.h"
+#include "log.h"
+
+
+/* Bytes of a shard copied per MPI-IO write during assembly */
+#define MPI_ASSEMBLE_BUF  (8 << 20)
+
+
+extern int mpi_rank;
+extern int mpi_size;
+
+
+void mpi_split_init(int * argc, char *** argv);
+void mpi_split_finalize(void);
+
+char * mpi_shard_name(char * split_file);
+
+void mpi_split_range(FILE              * fp, 
+                     sff_common_header * ch, 
+                     off_t               data_start, 
+                     off_t               data_end, 
+                     off_t             * range_start, 
+                     off_t             * range_end);
+
+void mpi_split_reduce(uint32_t          nreads_local, 
+                      sff_common_header * ch, 
+                      int               num_patterns, 
+                      uint32_t        * nreads_split_file, 
+                      uint32_t        * nreads_short_split, 
+                      uint32_t        * nreads_filtered, 
+                      int               nfilters);
+
+void mpi_perf_reduce(uint64_t * counts, int n);
+
+void mpi_split_assemble(sff_common_header * ch, 
+                        int               num_patterns, 
+                        char           ** split_files, 
+                        char           ** shard_files, 
+                        uint32_t        * nreads_split_file);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _NUMA_SPLIT_H_
+#define _NUMA_SPLIT_H_
+
+#include <stdint.h>
+
+#include "reorder.h"
+#include "log.h"
+
+
+#define NUMA_MAX_NODES     MAX_CHUNK_NODES
+
+#define NUMA_SYSFS_NODES   "/sys/devices/system/node"
+
+
+/*
+ * The NUMA nodes that have CPUs this process may run on
+ */
+typedef struct {
+    int    nnodes;
+    int    node_id[NUMA_MAX_NODES];   /* kernel number of the node */
+    int    ncpus[NUMA_MAX_NODES];
+    int  * cpus[NUMA_MAX_NODES];      /* the CPUs of the node      */
+} numa_topology;
+
+
+/*
+ * Routes the chunks to the threads of the node that holds 
+ * their memory: the reader queues each chunk on its node, 
+ * and a classifier task takes a chunk from the queue of 
+ * its own node, or from another node when its queue is empty
+ */
+typedef struct {
+    sff_read_chunk * head[NUMA_MAX_NODES];
+    sff_read_chunk * tail[NUMA_MAX_NODES];
+    omp_lock_t       lock;
+
+    int              nthreads;
+    int            * thread_node;       /* node of each thread */
+
+    uint64_t         nchunks_local;     /* classified on their node    */
+    uint64_t         nchunks_remote;    /* taken by another node       */
+    uint64_t         bytes_remote;      /* arena bytes of the latter   */
+    uint64_t         bytes_remote_fill; /* read into another node's arenas */
+} numa_router;
+
+
+extern numa_topology numa_topo;
+
+
+int  numa_init(numa_topology * t);
+int  numa_pin_thread(numa_topology * t, int tid, int nthreads);
+int  numa_thread_node(void);
+void numa_bind_memory(void * p, size_t len, int node);
+
+void numa_router_init(numa_router * r, int nthreads);
+void numa_router_free(numa_router * r);
+int  numa_chunk_node(numa_router * r, uint32_t chunk_num);
+void numa_router_put(numa_router * r, sff_read_chunk * chunk);
+sff_read_chunk * numa_router_take(numa_router * r);
+void numa_router_report(numa_router * r);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#include <stdint.h>
+
+#include "log.h"
+
+
+/* Stages of the split pipeline that are measured */
+#define PERF_READ           0
+#define PERF_CLASSIFY       1
+#define PERF_WRITE          2
+#define PERF_COMPRESS       3
+#define PERF_NSTAGES        4
+
+/* Events counted with perf_event_open() */
+#define PERF_CYCLES         0
+#define PERF_INSTRUCTIONS   1
+#define PERF_LLC_MISSES     2
+#define PERF_BRANCH_MISSES  3
+#define PERF_CTX_SWITCHES   4
+#define PERF_NEVENTS        5
+
+/* Slot after the events that holds the time, in ns */
+#define PERF_TIME           PERF_NEVENTS
+
+/* Max nesting of the stages on a thread */
+#define PERF_MAX_DEPTH      8
+
+
+/*
+ * The counters of one thread: they are opened by the thread 
+ * the first time it enters a stage, and the counts are 
+ * charged to the innermost stage the thread is in
+ */
+typedef struct {
+    int       fd[PERF_NEVENTS];           /* -1: event not available */
+    int       opened;
+
+    int       depth;
+    int       stack[PERF_MAX_DEPTH];
+    uint64_t  start[PERF_NEVENTS + 1];
+} perf_thread;
+
+
+extern int perf_enabled;
+
+
+/*
+ * When --perf is off, a counted stage costs one branch
+ */
+#define PERF_BEGIN(stage)  do { if ( __builtin_expect(perf_enabled, 0) ) perf_begin(stage); } while (0)
+#define PERF_END()         do { if ( __builtin_expect(perf_enabled, 0) ) perf_end(); } while (0)
+
+
+void perf_init(int nthreads);
+void perf_begin(int stage);
+void perf_end(void);
+uint64_t * perf_counts(int * n);
+void perf_report(void);
+void perf_free(void);
+
+#endif
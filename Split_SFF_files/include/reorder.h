@@ -0,0 +1,103 @@
+#ifndef _REORDER_H_
+#define _REORDER_H_
+
+#include "sff.h"
+#include "arena.h"
+#include "log.h"
+
+
+#ifdef _OPENMP
+  #include <omp.h>
+#else
+  // Serial build: locks are no-ops
+  typedef int omp_lock_t;
+  #define omp_init_lock(l)     ((void)(l))
+  #define omp_destroy_lock(l)  ((void)(l))
+  #define omp_set_lock(l)      ((void)(l))
+  #define omp_unset_lock(l)    ((void)(l))
+  #define omp_test_lock(l)     (1)
+  #define omp_get_thread_num()   0
+  #define omp_get_num_threads()  1
+  #define omp_get_max_threads()  1
+#endif
+
+
+/* Max number of NUMA nodes that hold chunks */
+#define MAX_CHUNK_NODES  64
+
+
+/*
+ * A split that a read goes to, together with the read header 
+ * to write to that split (the header may have been trimmed)
+ */
+typedef struct {
+    int              pat_idx;
+    sff_read_header  rh_trim;
+} sff_read_hit;
+
+
+/*
+ * A read together with the result of its classification
+ */
+typedef struct {
+    sff_read_header  rh;
+    sff_read_data    rd;
+    uint32_t         read_num;
+    int              nhits;
+    int              hit_cap;
+    sff_read_hit   * hits;
+} sff_split_read;
+
+
+/*
+ * A chunk of consecutive reads: the unit of work that flows 
+ * from the reader to the classifier threads and to the 
+ * writer. The names, bases, quality and flowgram arrays of 
+ * the reads and their hits are packed, in read order, in the 
+ * arena of the chunk. Freed chunks are kept in a pool and 
+ * reused with their arena, so that, once the pipeline is 
+ * full, reading a chunk does not call the allocator.
+ */
+typedef struct sff_read_chunk {
+    uint32_t                first_read;   /* read_num of reads[0]  */
+    uint32_t                nreads;
+    uint32_t                capacity;     /* size of reads[]       */
+    int                     node;         /* NUMA node of the arena */
+    sff_split_read        * reads;
+    sff_arena               arena;
+    struct sff_read_chunk * next_free;    /* link in the pool      */
+} sff_read_chunk;
+
+
+/*
+ * Reorder stage: chunks are classified out of order by 
+ * the classifier threads and are emitted in increasing 
+ * order of read_num. At most nslots chunks can be 
+ * in flight, so the memory used is bounded.
+ */
+typedef struct {
+    uint32_t          nslots;
+    uint32_t          chunk_size;
+    uint32_t          next_read;   /* read_num of the next read to emit */
+    sff_read_chunk ** slots;       /* slots[(read_num / chunk_size) % nslots] */
+    omp_lock_t        lock;        /* held by the thread emitting chunks */
+} reorder_buffer;
+
+
+typedef void (*emit_chunk_fn)(sff_read_chunk * chunk);
+
+
+sff_read_chunk * alloc_read_chunk(uint32_t first_read, uint32_t nreads, int node);
+void free_read_chunk(sff_read_chunk * chunk);
+void free_chunk_pool(void);
+
+void add_read_hit(sff_read_chunk * chunk, sff_split_read * sr, int pat_idx, sff_read_header * rh_trim);
+
+void reorder_init(reorder_buffer * rb, uint32_t nslots, uint32_t chunk_size);
+void reorder_free(reorder_buffer * rb);
+
+int  reorder_has_room(reorder_buffer * rb, uint32_t first_read);
+void reorder_put(reorder_buffer * rb, sff_read_chunk * chunk);
+void reorder_drain(reorder_buffer * rb, emit_chunk_fn emit);
+
+#endif
@@ -19,8 +19,11 @@
 #ifndef _SFF_H_
 #define _SFF_H_
 
+#include <stdio.h>
 #include <stdint.h>
+#include <sys/types.h>
 
+#include "arena.h"
 #include "log.h"
 
 
@@ -88,6 +91,18 @@ extern "C" {
 #define SFF_VERSION_LENGTH 4
 #define PADDING_SIZE 8
 
+/* Consecutive valid records needed to accept a record boundary */
+#define SFF_SYNC_RECORDS  3
+
+/* Reads longer than this are taken as a failed resync */
+#define SFF_MAX_BASES     65535
+
+/* Bytes of the fixed-size fields at the start of a read header */
+#define SFF_READ_HEADER_FIXED  16
+
+/* Suffix of the sidecar read index of an SFF file */
+#define SFF_INDEX_SUFFIX  ".ridx"
+
 #define min(a,b) ( (a) < (b) ? (a) : (b) )
 #define max(a,b) ( (a) > (b) ? (a) : (b) )
 
@@ -127,12 +142,18 @@ typedef struct {
 /*
  * The read_data section per reading, following the read_header.
  * It is padded to an 8-byte boundary.
+ *
+ * When the section is read lazily, raw holds the section as 
+ * stored in the file; flow_index, bases and quality point into 
+ * raw at the offsets of these fields, and the big endian 
+ * flowgram is decoded only on request (get_read_flowgram).
  */
 typedef struct {
     uint16_t *flowgram;   /* x 100.0 */
     uint8_t  *flow_index; /* relative to last */
     char     *bases;
     uint8_t  *quality;
+    uint8_t  *raw;        /* NULL unless read lazily */
 } sff_read_data;
 
 
@@ -148,6 +169,8 @@ typedef struct {
 
 void convert_big_endian_common_header_2_host(sff_common_header *h);
 void convert_big_endian_read_header_2_host(sff_read_header *rh);
+void convert_big_endian_16(uint16_t *dst, const uint16_t *src, size_t n);
+const char * byteswap_kernel_name(void);
 
 
 /* function to read the sff file */
@@ -160,6 +183,7 @@ void verify_sff_common_header(char *prg_name,
                               sff_common_header *h);
 
 void read_sff_read_header(FILE *fp, sff_read_header *rh);
+void write_sff_read_header(FILE *fp, sff_read_header *rh);
 void free_sff_read_header(sff_read_header *rh);
 
 void read_padding(FILE *fp, int header_size);
@@ -171,6 +195,21 @@ void read_sff_read_data(FILE *fp,
 		   uint32_t nbases, 
 		   uint32_t read_num);
 
+void read_sff_read_record(FILE *fp, 
+                   sff_read_header *rh, 
+                   sff_read_data *rd, 
+                   uint16_t nflows, 
+                   sff_arena *arena);
+
+void read_sff_read_data_lazy(FILE *fp, 
+                   sff_read_data *rd, 
+                   uint16_t nflows, 
+		   uint32_t nbases, 
+		   uint32_t read_num);
+
+uint16_t * get_read_flowgram(sff_read_data *rd, 
+                   uint16_t nflows);
+
 void write_sff_read_data(FILE *fp, 
                    sff_read_data *rd, 
                    uint16_t nflows, 
@@ -196,6 +235,41 @@ uint8_t* get_read_quality_values(sff_read_data rd,
                                 int left_clip,
                                 int right_clip);
 
+off_t sff_read_data_size(sff_common_header * ch, uint32_t nbases);
+
+void sff_data_range(FILE              * fp, 
+                    sff_common_header * ch, 
+                    off_t             * data_start, 
+                    off_t             * data_end);
+
+int probe_read_record(FILE              * fp, 
+                      sff_common_header * ch, 
+                      off_t               offset, 
+                      off_t               data_end, 
+                      off_t             * next);
+
+int resync_read_record(FILE              * fp, 
+                       sff_common_header * ch, 
+                       off_t               start, 
+                       off_t               data_end, 
+                       off_t             * rec_offset);
+
+void build_read_index(FILE              * fp, 
+                      sff_common_header * ch, 
+                      off_t               data_start, 
+                      off_t               data_end, 
+                      off_t            ** offsets);
+
+int load_read_index(char              * idx_file, 
+                    sff_common_header * ch, 
+                    off_t               data_end, 
+                    off_t            ** offsets);
+
+int save_read_index(char              * idx_file, 
+                    sff_common_header * ch, 
+                    off_t               data_end, 
+                    off_t             * offsets);
+
 void bailout(FILE *fp, char * msg, int err);
 
 
@@ -0,0 +1,63 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+#include "log.h"
+
+
+/* Stages of the split pipeline that are traced */
+#define TRACE_READ          0
+#define TRACE_CLASSIFY      1
+#define TRACE_WRITE         2
+#define TRACE_FLUSH         3
+#define TRACE_COMPRESS      4
+#define TRACE_WAIT          5
+#define TRACE_NSTAGES       6
+
+/* Default number of events kept per thread */
+#define TRACE_DEFAULT_EVENTS  (1 << 16)
+
+/* Max nesting of the stages when pairing the events */
+#define TRACE_MAX_DEPTH     8
+
+
+/*
+ * A begin or end event of a stage
+ */
+typedef struct {
+    uint64_t  ts;        /* ns since trace_init() */
+    int64_t   arg;       /* first read of the chunk, split number, ... */
+    uint8_t   stage;
+    uint8_t   phase;     /* 'B' or 'E' */
+} trace_event;
+
+
+/*
+ * The ring of events of one thread; only the thread writes
+ * to it, so no lock is needed. When the ring is full, the
+ * oldest events are overwritten.
+ */
+typedef struct {
+    trace_event * events;
+    uint64_t      head;      /* number of events recorded */
+    char          pad[48];   /* one cache line per thread */
+} trace_ring;
+
+
+extern int trace_enabled;
+
+
+/*
+ * When tracing is off, a traced stage costs one branch
+ */
+#define TRACE_BEGIN(stage, arg)  do { if ( __builtin_expect(trace_enabled, 0) ) trace_record((stage), 'B', (arg)); } while (0)
+#define TRACE_END(stage, arg)    do { if ( __builtin_expect(trace_enabled, 0) ) trace_record((stage), 'E', (arg)); } while (0)
+
+
+void trace_init(int nthreads, uint32_t nevents);
+void trace_record(int stage, int phase, int64_t arg);
+void trace_dump(char * file, int pid);
+void trace_free(void);
+
+#endif
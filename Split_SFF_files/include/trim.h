@@ -0,0 +1,39 @@
+#ifndef _TRIM_H_
+#define _TRIM_H_
+
+#include "sff.h"
+#include "log.h"
+
+
+/*
+ * Trimming policies applied to a read while it is being 
+ * written to its split. Trimming only updates the clip 
+ * fields of the read header; the bases, quality and 
+ * flowgram arrays are written unchanged.
+ */
+typedef struct {
+    int  qual_threshold;   /* min mean quality of a window; 0 disables */
+    int  qual_window;      /* sliding window size in bases             */
+    int  remove_barcode;   /* clip the matched barcode on the left     */
+    int  min_length;       /* min clipped length to keep; 0 disables   */
+} sff_trim_options;
+
+
+#define TRIM_DEFAULT_WINDOW  10
+
+
+int trim_enabled(sff_trim_options * opt);
+
+int trim_quality_window(uint8_t * quality, 
+                        int       left, 
+                        int       right, 
+                        int       window, 
+                        int       threshold);
+
+int trim_read_header(sff_read_header  * rh_trim, 
+                     sff_read_header  * rh, 
+                     sff_read_data    * rd, 
+                     sff_trim_options * opt, 
+                     int                barcode_end);
+
+#endif
@@ -0,0 +1,177 @@
+/*
+
+  A bump allocator for the reads of a chunk: the 
+  variable-length fields of the reads are packed 
+  in a few large blocks, which are reused from one 
+  chunk to the next.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+
+
+
+void arena_init(sff_arena * a) 
+{
+
+  a->head = NULL;
+  a->cur  = NULL;
+  a->node = -1;
+  a->bind = NULL;
+
+} // arena_init()
+
+
+
+static sff_arena_block * arena_new_block(sff_arena * a, size_t size) 
+{
+
+  sff_arena_block * b = malloc( sizeof(sff_arena_block) );
+  if ( b ) {
+    if ( a->bind != NULL ) {
+      // Page aligned, and bound before the first touch
+      if ( posix_memalign( (void **) &(b->data), ARENA_PAGE_SIZE, size ) != 0 ) {
+	b->data = NULL;
+      }
+      else {
+	a->bind(b->data, size, a->node);
+      }
+    }
+    else {
+      b->data = malloc( size );
+    }
+  }
+  if ( ! b || ! b->data ) {
+    fprintf(stderr, "Out of memory! Could not allocate an arena block of %zu bytes\n", size);
+    exit(1);
+  }
+
+  b->next = NULL;
+  b->size = size;
+  b->used = 0;
+
+  return b;
+
+} // arena_new_block()
+
+
+
+//
+// Return n bytes, aligned to ARENA_ALIGN, from the current 
+// block, moving to the next block (or adding one) when the 
+// current block is full
+//
+void * arena_alloc(sff_arena * a, size_t n) 
+{
+
+  sff_arena_block * b = a->cur;
+  void * p;
+
+  n = (n + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+
+  while ( b != NULL && b->used + n > b->size ) {
+    b = b->next;
+    if ( b != NULL ) {
+      b->used = 0;
+    }
+  }
+
+  if ( b == NULL ) {
+    b = arena_new_block( a, n > ARENA_BLOCK_SIZE ? n : ARENA_BLOCK_SIZE );
+    if ( a->cur == NULL ) {
+      a->head = b;
+    }
+    else {
+      // Append after the last block
+      sff_arena_block * last = a->cur;
+      while ( last->next != NULL ) {
+	last = last->next;
+      }
+      last->next = b;
+    }
+  }
+
+  a->cur = b;
+
+  p = b->data + b->used;
+  b->used += n;
+
+  return p;
+
+} // arena_alloc()
+
+
+
+//
+// Release all the allocations, keeping the blocks
+//
+void arena_reset(sff_arena * a) 
+{
+
+  a->cur = a->head;
+  if ( a->cur != NULL ) {
+    a->cur->used = 0;
+  }
+
+} // arena_reset()
+
+
+
+//
+// Bind the blocks allocated from now on to a NUMA node
+//
+void arena_set_node(sff_arena * a, int node, void (* bind)(void * p, size_t len, int node)) 
+{
+
+  a->node = node;
+  a->bind = bind;
+
+} // arena_set_node()
+
+
+
+//
+// Number of bytes allocated since the last reset
+//
+size_t arena_bytes(sff_arena * a) 
+{
+
+  sff_arena_block * b;
+  size_t n = 0;
+
+  for (b = a->head; b != NULL; b = b->next) {
+    n += b->used;
+    if ( b == a->cur ) {
+      break;
+    }
+  }
+
+  return n;
+
+} // arena_bytes()
+
+
+
+void arena_free(sff_arena * a) 
+{
+
+  sff_arena_block * b = a->head, * next;
+
+  while ( b != NULL ) {
+    next = b->next;
+    free(b->data);
+    free(b);
+    b = next;
+  }
+
+  arena_init(a);
+
+} // arena_free()
@@ -0,0 +1,522 @@
+/*
+
+  Block-compressed output for the split files. 
+
+  A split is written as a sequence of gzip members of at 
+  most 64 KB of uncompressed data each (the BGZF layout of 
+  SAM/BAM), so the file can be decompressed with gzip, and 
+  each block can be decompressed on its own. The blocks are 
+  compressed by OpenMP tasks while the matching continues, 
+  and a sidecar index (.gzi) records the compressed and 
+  uncompressed offset of each block for random access.
+
+  The common header of the SFF file is kept in a block of 
+  its own, stored without compression, so the number of 
+  reads can be updated in place when the split is closed.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "bgzf.h"
+
+
+
+/** GLOBALS **/
+
+// Number of blocks queued for compression, over all splits
+static int bgzf_pending = 0;
+
+// The end-of-file marker: an empty block
+static const uint8_t bgzf_eof[28] = {
+    0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 
+    0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+
+
+/** FUNCTIONS **/
+
+
+static void 
+put_le16(uint8_t * p, uint16_t v) 
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+
+static void 
+put_le32(uint8_t * p, uint32_t v) 
+{
+    put_le16(p, v & 0xffff);
+    put_le16(p + 2, v >> 16);
+}
+
+
+static void 
+put_le64(uint8_t * p, uint64_t v) 
+{
+    put_le32(p, v & 0xffffffff);
+    put_le32(p + 4, v >> 32);
+}
+
+
+
+//
+// Compress len bytes of data into a gzip member with the BGZF 
+// extra field, and return the size of the member. Level 0, 
+// or data that do not compress, give a stored block, whose 
+// size depends only on len.
+//
+size_t 
+bgzf_deflate_block(char * cdata, char * data, size_t len, int level) 
+{
+
+    uint8_t  * out = (uint8_t *) cdata;
+    size_t     clen = 0;
+    z_stream   zs;
+
+    //
+    // 1. Deflate the data after the gzip header
+    //
+    if ( level > 0 ) {
+
+        memset(&zs, 0, sizeof(zs));
+        if ( deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK ) {
+            fprintf(stderr, "[err] Could not initialize zlib\n");
+            exit(1);
+        }
+
+        zs.next_in   = (Bytef *) data;
+        zs.avail_in  = (uInt) len;
+        zs.next_out  = out + BGZF_HEADER_SIZE;
+        zs.avail_out = BGZF_MAX_BLOCK - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+
+        if ( deflate(&zs, Z_FINISH) == Z_STREAM_END ) {
+            clen = zs.total_out;
+        }
+        deflateEnd(&zs);
+    }
+
+    if ( clen == 0 ) {
+        // A single stored deflate block: final bit, LEN, NLEN
+        uint8_t * p = out + BGZF_HEADER_SIZE;
+        p[0] = 0x01;
+        put_le16(p + 1, (uint16_t) len);
+        put_le16(p + 3, (uint16_t) ~len);
+        memcpy(p + 5, data, len);
+        clen = 5 + len;
+    }
+
+
+    //
+    // 2. The gzip header, with the size of the member 
+    //    in the BC extra subfield, and the footer
+    //
+    size_t bsize = BGZF_HEADER_SIZE + clen + BGZF_FOOTER_SIZE;
+
+    out[0]  = 0x1f;  out[1] = 0x8b;  out[2] = 0x08;  out[3] = 0x04;
+    put_le32(out + 4, 0);                   // mtime
+    out[8]  = 0x00;  out[9] = 0xff;         // xfl, os
+    put_le16(out + 10, 6);                  // xlen
+    out[12] = 'B';   out[13] = 'C';
+    put_le16(out + 14, 2);
+    put_le16(out + 16, (uint16_t) (bsize - 1));
+
+    put_le32(out + BGZF_HEADER_SIZE + clen,     crc32(crc32(0L, Z_NULL, 0), (Bytef *) data, (uInt) len));
+    put_le32(out + BGZF_HEADER_SIZE + clen + 4, (uint32_t) len);
+
+    return bsize;
+
+} // bgzf_deflate_block()
+
+
+
+//
+// Write the compressed blocks that are next in order. 
+// Called with bf->lock held.
+//
+static void 
+bgzf_write_ready(bgzf_file * bf) 
+{
+
+    while ( bf->done != NULL && bf->done->seq == bf->write_seq ) {
+
+        bgzf_block * blk = bf->done;
+        bf->done = blk->next;
+
+        if ( fwrite(blk->cdata, 1, blk->clen, bf->fp) != blk->clen ) {
+            fprintf(stderr, "[err] Could not write a block to '%s'\n", bf->file_name);
+            exit(1);
+        }
+
+        if ( bf->nblocks == bf->index_cap ) {
+            bf->index_cap = bf->index_cap ? 2 * bf->index_cap : 1024;
+            bf->index = realloc(bf->index, 2 * bf->index_cap * sizeof(uint64_t));
+            if ( ! bf->index ) {
+                fprintf(stderr, "Out of memory! Could not grow the block index\n");
+                exit(1);
+            }
+        }
+        bf->index[2 * bf->nblocks]     = (uint64_t) bf->coffset;
+        bf->index[2 * bf->nblocks + 1] = (uint64_t) blk->uoffset;
+        bf->nblocks++;
+
+        bf->coffset += blk->clen;
+        bf->write_seq++;
+
+        free(blk->cdata);
+        free(blk);
+    }
+
+} // bgzf_write_ready()
+
+
+
+//
+// Compress a block and write the blocks that are ready
+//
+static void 
+bgzf_compress_block(bgzf_file * bf, bgzf_block * blk, int level) 
+{
+
+    bgzf_block ** p;
+
+    blk->cdata = malloc(BGZF_MAX_BLOCK);
+    if ( ! blk->cdata ) {
+        fprintf(stderr, "Out of memory! Could not allocate a compressed block\n");
+        exit(1);
+    }
+    PERF_BEGIN(PERF_COMPRESS);
+    TRACE_BEGIN(TRACE_COMPRESS, blk->seq);
+    blk->clen = bgzf_deflate_block(blk->cdata, blk->data, blk->len, level);
+    TRACE_END(TRACE_COMPRESS, blk->seq);
+    PERF_END();
+    free(blk->data);
+    blk->data = NULL;
+
+    omp_set_lock( &(bf->lock) );
+
+    for (p = &(bf->done); *p != NULL && (*p)->seq < blk->seq; p = &((*p)->next));
+    blk->next = *p;
+    *p = blk;
+
+    bgzf_write_ready(bf);
+
+    omp_unset_lock( &(bf->lock) );
+
+} // bgzf_compress_block()
+
+
+
+//
+// Hand the current block over to a compression task. 
+// When too many blocks are queued, compress it inline.
+//
+static void 
+bgzf_submit_block(bgzf_file * bf) 
+{
+
+    int pending;
+    bgzf_block * blk;
+
+    if ( bf->len == 0 ) {
+        return;
+    }
+
+    blk = calloc(1, sizeof(bgzf_block));
+    if ( ! blk ) {
+        fprintf(stderr, "Out of memory! Could not allocate a block\n");
+        exit(1);
+    }
+
+    blk->seq     = bf->next_seq++;
+    blk->data    = bf->buf;
+    blk->len     = bf->len;
+    blk->uoffset = bf->uoffset;
+
+    bf->uoffset += bf->len;
+    bf->len = 0;
+    bf->buf = malloc(BGZF_BLOCK_SIZE);
+    if ( ! bf->buf ) {
+        fprintf(stderr, "Out of memory! Could not allocate a block\n");
+        exit(1);
+    }
+
+    //
+    // The header block is stored, so its size does not 
+    // change when the number of reads is updated
+    //
+    if ( blk->seq == 0 ) {
+        bgzf_compress_block(bf, blk, 0);
+        return;
+    }
+
+    #pragma omp atomic capture
+    pending = bgzf_pending++;
+    (void) pending;   // unused in the serial build
+
+    #pragma omp task firstprivate(bf, blk) if(pending < BGZF_MAX_PENDING)
+    {
+        bgzf_compress_block(bf, blk, bf->level);
+
+        #pragma omp atomic
+        bgzf_pending--;
+    }
+
+} // bgzf_submit_block()
+
+
+
+static ssize_t 
+bgzf_cookie_write(void * cookie, const char * data, size_t size) 
+{
+
+    bgzf_file * bf = cookie;
+    size_t done = 0;
+
+    //
+    // After a rewind, the writes update the common header
+    //
+    if ( bf->hdr_rewrite ) {
+        if ( bf->hdr_pos + size > bf->hdr_len ) {
+            fprintf(stderr, "[err] Only the common header of '%s' can be rewritten\n", bf->file_name);
+            exit(1);
+        }
+        memcpy(bf->hdr + bf->hdr_pos, data, size);
+        bf->hdr_pos += size;
+        return size;
+    }
+
+    while ( done < size ) {
+
+        size_t n = min(size - done, BGZF_BLOCK_SIZE - bf->len);
+
+        memcpy(bf->buf + bf->len, data + done, n);
+        bf->len += n;
+        done    += n;
+
+        if ( bf->len == BGZF_BLOCK_SIZE ) {
+            bgzf_submit_block(bf);
+        }
+    }
+
+    return size;
+
+} // bgzf_cookie_write()
+
+
+
+//
+// The only seeks supported are querying the position 
+// and rewinding to rewrite the common header
+//
+static int 
+bgzf_cookie_seek(void * cookie, off64_t * offset, int whence) 
+{
+
+    bgzf_file * bf = cookie;
+
+    if ( whence == SEEK_CUR && *offset == 0 ) {
+        *offset = bf->hdr_rewrite ? (off64_t) bf->hdr_pos : (off64_t) (bf->uoffset + bf->len);
+        return 0;
+    }
+
+    if ( whence == SEEK_SET && *offset == 0 ) {
+        bgzf_submit_block(bf);
+        bf->hdr_rewrite = 1;
+        bf->hdr_pos = 0;
+        return 0;
+    }
+
+    return -1;
+
+} // bgzf_cookie_seek()
+
+
+
+//
+// Write the block index: the number of blocks after the 
+// first one, then the compressed and uncompressed offsets 
+// of each of these blocks, as 64-bit little endian integers 
+// (the .gzi format of bgzip)
+//
+static void 
+bgzf_write_index(bgzf_file * bf) 
+{
+
+    FILE    * fp;
+    uint8_t   v[8];
+    uint64_t  k;
+    size_t    sz = strlen(bf->file_name) + strlen(BGZF_INDEX_SUFFIX) + 1;
+    char      idx_file[sz];
+
+    snprintf(idx_file, sz, "%s%s", bf->file_name, BGZF_INDEX_SUFFIX);
+
+    if ( (fp = fopen(idx_file, "w")) == NULL ) {
+        fprintf(stderr, "[warn] Could not write the block index '%s'\n", idx_file);
+        return;
+    }
+
+    put_le64(v, bf->nblocks > 0 ? bf->nblocks - 1 : 0);
+    fwrite(v, 1, 8, fp);
+
+    for (k = 1; k < bf->nblocks; k++) {
+        put_le64(v, bf->index[2 * k]);
+        fwrite(v, 1, 8, fp);
+        put_le64(v, bf->index[2 * k + 1]);
+        fwrite(v, 1, 8, fp);
+    }
+
+    fclose(fp);
+
+} // bgzf_write_index()
+
+
+
+static int 
+bgzf_cookie_close(void * cookie) 
+{
+
+    bgzf_file * bf = cookie;
+    uint64_t    written;
+    char        cdata[BGZF_MAX_BLOCK];
+
+    //
+    // 1. Compress the last block, and wait until all 
+    //    the blocks are written
+    //
+    if ( ! bf->hdr_rewrite ) {
+        bgzf_submit_block(bf);
+    }
+
+    for (;;) {
+        omp_set_lock( &(bf->lock) );
+        written = bf->write_seq;
+        omp_unset_lock( &(bf->lock) );
+        if ( written == bf->next_seq ) {
+            break;
+        }
+        #pragma omp taskyield
+    }
+
+
+    //
+    // 2. Rewrite the header block in place, and 
+    //    mark the end of the file
+    //
+    if ( bf->hdr_rewrite ) {
+        size_t clen = bgzf_deflate_block(cdata, bf->hdr, bf->hdr_len, 0);
+        fseeko(bf->fp, 0, SEEK_SET);
+        fwrite(cdata, 1, clen, bf->fp);
+        fseeko(bf->fp, 0, SEEK_END);
+    }
+
+    if ( fwrite(bgzf_eof, 1, sizeof(bgzf_eof), bf->fp) != sizeof(bgzf_eof) ) {
+        fprintf(stderr, "[err] Could not write to '%s'\n", bf->file_name);
+        exit(1);
+    }
+
+    bgzf_write_index(bf);
+
+
+    //
+    // 3. Clean up
+    //
+    fclose(bf->fp);
+    omp_destroy_lock( &(bf->lock) );
+
+    free(bf->file_name);
+    free(bf->buf);
+    free(bf->index);
+    free(bf->hdr);
+    free(bf);
+
+    return 0;
+
+} // bgzf_cookie_close()
+
+
+
+//
+// Open a compressed split and write the common header to it, 
+// in a block of its own. The returned stream is used like 
+// the stream of an uncompressed split: it supports a rewind 
+// followed by the rewrite of the common header.
+//
+FILE * 
+bgzf_open_sff(char * file_name, sff_common_header * ch, int level) 
+{
+
+    cookie_io_functions_t io = {
+        .read  = NULL,
+        .write = bgzf_cookie_write,
+        .seek  = bgzf_cookie_seek,
+        .close = bgzf_cookie_close
+    };
+
+    FILE      * stream;
+    bgzf_file * bf;
+
+    if ( ch->header_len > BGZF_BLOCK_SIZE ) {
+        fprintf(stderr, "[err] The common header is too large for a compressed split\n");
+        exit(1);
+    }
+
+    bf = calloc(1, sizeof(bgzf_file));
+    if ( ! bf ) {
+        fprintf(stderr, "Out of memory! Could not allocate a compressed split\n");
+        exit(1);
+    }
+
+    if ( (bf->fp = fopen(file_name, "w")) == NULL ) {
+        free(bf);
+        return NULL;
+    }
+
+    bf->file_name = strdup(file_name);
+    bf->level     = level;
+    bf->buf       = malloc(BGZF_BLOCK_SIZE);
+    if ( ! bf->file_name || ! bf->buf ) {
+        fprintf(stderr, "Out of memory! Could not allocate a compressed split\n");
+        exit(1);
+    }
+    omp_init_lock( &(bf->lock) );
+
+    stream = fopencookie(bf, "w", io);
+    if ( stream == NULL ) {
+        fprintf(stderr, "[err] Could not create the stream for '%s'\n", file_name);
+        exit(1);
+    }
+
+
+    //
+    // Keep a copy of the common header, for the rewrite, 
+    // and write it as the first block
+    //
+    write_sff_common_header(stream, ch);
+    fflush(stream);
+
+    bf->hdr_len = bf->len;
+    bf->hdr = malloc(bf->hdr_len);
+    if ( ! bf->hdr ) {
+        fprintf(stderr, "Out of memory! Could not allocate the common header\n");
+        exit(1);
+    }
+    memcpy(bf->hdr, bf->buf, bf->hdr_len);
+
+    bgzf_submit_block(bf);
+
+    return stream;
+
+} // bgzf_open_sff()
@@ -0,0 +1,344 @@
+/*
+
+  Barcode census: estimate the number of reads per 
+  adapter from a sample of the reads of an SFF file, 
+  without parsing and matching every read.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#include "census.h"
+#include "main.h"
+
+
+
+static uint32_t census_read_index(FILE * fp, char * sff_file, sff_common_header * ch, 
+                                  off_t data_start, off_t data_end, off_t ** offsets);
+
+static void census_read(FILE * fp, sff_common_header * ch, char ** patterns, 
+                        int num_patterns, int opt_no_clipping, 
+                        uint32_t read_num, census_counts * cc);
+
+static void print_census(census_counts * cc, sff_common_header * ch, 
+                         char ** patterns, int num_patterns, 
+                         int mode, double seconds);
+
+
+
+//
+// Sample a fraction of the reads of sff_file, match the 
+// sampled reads against the patterns, and print the 
+// estimated number of reads per pattern
+//
+void census_sff(char   * sff_file, 
+                char  ** patterns, 
+                int      num_patterns, 
+                double   fraction, 
+                int      mode, 
+                int      opt_no_clipping) 
+{
+
+  sff_common_header ch;
+  census_counts     cc;
+  FILE            * fp;
+  off_t             data_start, data_end;
+  struct timespec   t0, t1;
+
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+
+  //
+  // 1. Setup
+  //
+  if ( (fp = fopen(sff_file, "r")) == NULL ) {
+    fprintf(stderr, "[err] Could not open sff file '%s' for reading.\n", sff_file);
+    exit(1);
+  }
+
+  read_sff_common_header(fp, &ch);
+  verify_sff_common_header(PRG_NAME, VERSION, &ch);
+
+  sff_data_range(fp, &ch, &data_start, &data_end);
+
+  memset(&cc, 0, sizeof(cc));
+  cc.hits     = calloc( num_patterns, sizeof(uint64_t) );
+  cc.pos_hist = calloc( (size_t) num_patterns * (CENSUS_MAX_POS + 1), sizeof(uint64_t) );
+  if ( ! cc.hits || ! cc.pos_hist ) {
+    fprintf(stderr, "Out of memory! Could not allocate the census counts\n");
+    exit(1);
+  }
+
+
+  //
+  // 2. Sample the reads
+  //
+  if ( mode == CENSUS_MODE_INDEX ) {
+
+    //
+    // 2.1 Systematic sample: every (1/fraction)-th read of the index
+    //
+    off_t  * offsets = NULL;
+    uint32_t nindex  = census_read_index(fp, sff_file, &ch, data_start, data_end, &offsets);
+    double   step    = 1.0 / fraction;
+    double   x;
+
+    for (x = step / 2; x < nindex; x += step) {
+      uint32_t r = (uint32_t) x;
+      fseeko(fp, offsets[r], SEEK_SET);
+      census_read(fp, &ch, patterns, num_patterns, opt_no_clipping, r, &cc);
+    }
+
+    free(offsets);
+
+  }
+  else {
+
+    //
+    // 2.2 Strided sample: split the data section into byte ranges, 
+    //     seek to the start of each range, resynchronize on the 
+    //     next record boundary, and sample a block of reads
+    //
+    uint64_t npoints = (uint64_t) ceil( fraction * ch.nreads / CENSUS_BLOCK_READS );
+    off_t    range, start, end, rec;
+    uint64_t j;
+    int      k;
+
+    if ( npoints == 0 ) {
+      npoints = 1;
+    }
+    range = (data_end - data_start) / npoints;
+    if ( range < PADDING_SIZE ) {
+      range = PADDING_SIZE;
+    }
+
+    for (j = 0; j < npoints; j++) {
+
+      start = data_start + (off_t) j * range;
+      end   = (j == npoints - 1) ? data_end : start + range;
+      if ( start >= data_end ) {
+	break;
+      }
+
+      // Record boundaries are aligned to PADDING_SIZE bytes
+      start -= (start - data_start) % PADDING_SIZE;
+
+      if ( ! resync_read_record(fp, &ch, start, data_end, &rec) ) {
+	fprintf2_(stderr, "No record boundary found after offset %lld\n", (long long) start);
+	continue;
+      }
+
+      fseeko(fp, rec, SEEK_SET);
+
+      for (k = 0; k < CENSUS_BLOCK_READS && rec < end; k++) {
+	census_read(fp, &ch, patterns, num_patterns, opt_no_clipping, 0, &cc);
+	rec = ftello(fp);
+      }
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+
+  //
+  // 3. Report
+  //
+  print_census(&cc, &ch, patterns, num_patterns, mode, 
+	       (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec));
+
+
+  //
+  // 4. Clean up
+  //
+  free(cc.hits);
+  free(cc.pos_hist);
+  free_sff_common_header(&ch);
+  fclose(fp);
+
+} // census_sff()
+
+
+
+//
+// Read the record at the current position of fp 
+// and add it to the census counts
+//
+static void 
+census_read(FILE * fp, sff_common_header * ch, char ** patterns, 
+            int num_patterns, int opt_no_clipping, 
+            uint32_t read_num, census_counts * cc) 
+{
+
+  sff_read_header rh, rh_trim;
+  sff_read_data   rd;
+  int             pat_idx, pos, nhits = 0;
+
+  read_sff_read_header(fp, &rh);
+  read_sff_read_data_lazy(fp, &rd, ch->flow_len, rh.nbases, read_num);
+
+  for (pat_idx = 0; pat_idx < num_patterns; pat_idx++) {
+
+    if ( match_read_pattern(ch, &rh, &rd, patterns, pat_idx, read_num, 
+			    opt_no_clipping, NULL, &rh_trim, &pos) == READ_NO_MATCH ) {
+      continue;
+    }
+
+    nhits++;
+    cc->hits[pat_idx]++;
+    cc->pos_hist[pat_idx * (CENSUS_MAX_POS + 1) + min(max(pos, 0), CENSUS_MAX_POS)]++;
+  }
+
+  cc->nsampled++;
+  if ( nhits == 0 ) {
+    cc->nunmatched++;
+  }
+
+  free_sff_read_header(&rh);
+  free_sff_read_data(&rd);
+
+} // census_read()
+
+
+
+//
+// Load the offsets of all the reads from the sidecar index 
+// <sff_file>.ridx, or build the index by scanning the read 
+// headers (skipping the data sections) and save it for the 
+// next census. Return the number of reads in the index.
+//
+static uint32_t 
+census_read_index(FILE              * fp, 
+                  char              * sff_file, 
+                  sff_common_header * ch, 
+                  off_t               data_start, 
+                  off_t               data_end, 
+                  off_t            ** offsets) 
+{
+
+  char idx_file[SFF_FILENAME_MAX_LENGTH + 8];
+
+  snprintf(idx_file, sizeof(idx_file), "%s%s", sff_file, SFF_INDEX_SUFFIX);
+
+  if ( load_read_index(idx_file, ch, data_end, offsets) ) {
+    return ch->nreads;
+  }
+
+  fprintf(stderr, "Building read index '%s' (one pass over the read headers)\n", idx_file);
+
+  build_read_index(fp, ch, data_start, data_end, offsets);
+
+  if ( ! save_read_index(idx_file, ch, data_end, *offsets) ) {
+    fprintf(stderr, "[warn] Could not write the read index '%s'\n", idx_file);
+  }
+
+  return ch->nreads;
+
+} // census_read_index()
+
+
+
+//
+// Wilson score interval at 95% confidence of a proportion 
+// estimated from a sample of n of the N reads. The sample is 
+// drawn without replacement, so the variance is scaled by the 
+// finite-population correction 1 - n/N, which is applied as 
+// z^2 (1 - f): the interval collapses to p for a full census
+//
+static void 
+wilson_interval(uint64_t k, uint64_t n, uint64_t N, double * lo, double * hi) 
+{
+
+  const double z = 1.96;
+  double p, f, z2, denom, center, half;
+
+  if ( n == 0 ) {
+    *lo = 0.0; 
+    *hi = 1.0;
+    return;
+  }
+
+  f      = N > n ? (double) n / N : 1.0;
+  z2     = z * z * (1.0 - f);
+  p      = (double) k / n;
+  denom  = 1.0 + z2 / n;
+  center = (p + z2 / (2.0 * n)) / denom;
+  half   = sqrt( z2 * (p * (1.0 - p) / n + z2 / (4.0 * n * n)) ) / denom;
+
+  *lo = max(center - half, 0.0);
+  *hi = min(center + half, 1.0);
+
+} // wilson_interval()
+
+
+
+static void 
+print_census(census_counts * cc, sff_common_header * ch, 
+             char ** patterns, int num_patterns, 
+             int mode, double seconds) 
+{
+
+  int    pat_idx, pos;
+  double lo, hi;
+
+  printf("Census: sampled %llu of %u reads (%.3f%%) by %s in %.3f s\n", 
+	 (unsigned long long) cc->nsampled, ch->nreads, 
+	 ch->nreads ? 100.0 * cc->nsampled / ch->nreads : 0.0, 
+	 mode == CENSUS_MODE_INDEX ? "read index" : "strided seeks", seconds);
+
+  printf("%-6s  %-16s  %10s  %12s  %25s\n", 
+	 "split", "adapter", "hits", "est_reads", "95% CI (reads)");
+
+  for (pat_idx = 0; pat_idx < num_patterns; pat_idx++) {
+
+    if ( cc->hits[pat_idx] == 0 ) {
+      continue;
+    }
+
+    wilson_interval(cc->hits[pat_idx], cc->nsampled, ch->nreads, &lo, &hi);
+    printf("%03d     %-16s  %10llu  %12.0f  %12.0f - %-12.0f\n", 
+	   pat_idx + 1, patterns[pat_idx], (unsigned long long) cc->hits[pat_idx], 
+	   (double) ch->nreads * cc->hits[pat_idx] / max(cc->nsampled, 1), 
+	   ch->nreads * lo, ch->nreads * hi);
+  }
+
+  wilson_interval(cc->nunmatched, cc->nsampled, ch->nreads, &lo, &hi);
+  printf("%-6s  %-16s  %10llu  %12.0f  %12.0f - %-12.0f\n", 
+	 "none", "-", (unsigned long long) cc->nunmatched, 
+	 (double) ch->nreads * cc->nunmatched / max(cc->nsampled, 1), 
+	 ch->nreads * lo, ch->nreads * hi);
+
+
+  //
+  // Histogram of the 0-based position of the first 
+  // base of the adapter in the read, as pos:count
+  //
+  printf("\nHit positions (pos:count, last bin is pos >= %d):\n", CENSUS_MAX_POS);
+
+  for (pat_idx = 0; pat_idx < num_patterns; pat_idx++) {
+
+    uint64_t * hist = &(cc->pos_hist[pat_idx * (CENSUS_MAX_POS + 1)]);
+
+    if ( cc->hits[pat_idx] == 0 ) {
+      continue;
+    }
+
+    printf("%03d     %-16s ", pat_idx + 1, patterns[pat_idx]);
+    for (pos = 0; pos <= CENSUS_MAX_POS; pos++) {
+      if ( hist[pos] ) {
+	printf(" %d:%llu", pos, (unsigned long long) hist[pos]);
+      }
+    }
+    printf("\n");
+  }
+
+} // print_census()
@@ -0,0 +1,156 @@
+/*
+
+  Predicates to filter the reads of an SFF file 
+  before they are matched against the adapters, 
+  so that no separate filtering pass over the 
+  splits is needed.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+  #include <immintrin.h>
+#endif
+
+#include "filter.h"
+
+
+
+//
+// Return non-zero if any filter predicate is active
+//
+int filter_enabled(sff_filter_options * opt) 
+{
+
+  if ( opt == NULL ) {
+    return 0;
+  }
+
+  return opt->min_length > 0 || opt->min_mean_qual > 0 || opt->max_homopolymer > 0;
+
+} // filter_enabled()
+
+
+
+
+//
+// Sum of the n quality values. With SSE2 (AVX2 when enabled 
+// at compile time), psadbw sums groups of 8 bytes against 
+// zero into 64-bit lanes, 16 (32) bytes per instruction.
+//
+uint64_t filter_quality_sum(uint8_t * quality, uint32_t n) 
+{
+
+  uint64_t sum = 0;
+  uint32_t i = 0;
+
+#if defined(__AVX2__)
+
+  __m256i zero = _mm256_setzero_si256();
+  __m256i acc  = _mm256_setzero_si256();
+
+  for ( ; i + 32 <= n; i += 32) {
+    __m256i q = _mm256_loadu_si256( (__m256i *) (quality + i) );
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(q, zero));
+  }
+
+  sum += (uint64_t) _mm256_extract_epi64(acc, 0) + (uint64_t) _mm256_extract_epi64(acc, 1) 
+       + (uint64_t) _mm256_extract_epi64(acc, 2) + (uint64_t) _mm256_extract_epi64(acc, 3);
+
+#elif defined(__SSE2__)
+
+  __m128i zero = _mm_setzero_si128();
+  __m128i acc  = _mm_setzero_si128();
+
+  for ( ; i + 16 <= n; i += 16) {
+    __m128i q = _mm_loadu_si128( (__m128i *) (quality + i) );
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(q, zero));
+  }
+
+  sum += (uint64_t) _mm_cvtsi128_si64(acc) 
+       + (uint64_t) _mm_cvtsi128_si64( _mm_unpackhi_epi64(acc, acc) );
+
+#endif
+
+  // Tail, or the whole array without SIMD
+  for ( ; i < n; i++) {
+    sum += quality[i];
+  }
+
+  return sum;
+
+} // filter_quality_sum()
+
+
+
+
+//
+// Length of the longest run of identical bases
+//
+uint32_t filter_longest_homopolymer(char * bases, uint32_t n) 
+{
+
+  uint32_t i, run = 1, longest = 1;
+
+  if ( n == 0 ) {
+    return 0;
+  }
+
+  for (i = 1; i < n; i++) {
+    if ( bases[i] == bases[i-1] ) {
+      run++;
+      if ( run > longest ) {
+	longest = run;
+      }
+    }
+    else {
+      run = 1;
+    }
+  }
+
+  return longest;
+
+} // filter_longest_homopolymer()
+
+
+
+
+//
+// Evaluate the filter predicates, cheapest first, and 
+// return FILTER_PASS or the predicate that rejects the read
+//
+int filter_read(sff_filter_options * opt, 
+                sff_read_header    * rh, 
+                sff_read_data      * rd) 
+{
+
+  uint32_t n = rh->nbases;
+
+  if ( opt->min_length > 0 && n < (uint32_t) opt->min_length ) {
+    fprintf_m(stderr, "\tRead with %u bases is too short\n", n);
+    return FILTER_LENGTH;
+  }
+
+  // Compare the sums, to avoid a division per read
+  if ( opt->min_mean_qual > 0 && 
+       ( n == 0 || filter_quality_sum(rd->quality, n) < (uint64_t) opt->min_mean_qual * n ) ) {
+    fprintf_m(stderr, "\tRead has mean quality below %d\n", opt->min_mean_qual);
+    return FILTER_QUALITY;
+  }
+
+  if ( opt->max_homopolymer > 0 && 
+       filter_longest_homopolymer(rd->bases, n) > (uint32_t) opt->max_homopolymer ) {
+    fprintf_m(stderr, "\tRead has a homopolymer longer than %d\n", opt->max_homopolymer);
+    return FILTER_HOMOPOLYMER;
+  }
+
+  return FILTER_PASS;
+
+} // filter_read()
@@ -21,6 +21,7 @@
 #include <string.h>
 #include <signal.h>
 #include <unistd.h>
+#include <getopt.h>
 #include "main.h"
 
 
@@ -33,6 +34,11 @@ char ad_file[ADAPTER_FILENAME_MAX_LENGTH] = { '\0' };
 FILE * sff_split_fp[MAX_NUM_ADAPTERS] = { NULL }; 
 char * sff_split_file[MAX_NUM_ADAPTERS] = { NULL }; 
 
+#ifdef USE_MPI
+// The per-rank shards of the split files
+char * sff_shard_file[MAX_NUM_ADAPTERS] = { NULL }; 
+#endif
+
 // Ignore clipping values for the discovery of the adapter, 
 // i.e., look for the adapter in the whole sequence
 int  opt_no_clipping = 0;
@@ -40,14 +46,59 @@ int  opt_no_clipping = 0;
 // Dry run: do not write the split .sff files
 int dry_run = 0;
 
+// Trimming policies applied to the reads written to the splits
+sff_trim_options trim_opts = { 0, TRIM_DEFAULT_WINDOW, 0, 0 };
+
 uint32_t * nreads_split_file = NULL;
 
+// Number of matching reads dropped because they were too short after trimming
+uint32_t * nreads_short_split = NULL;
+
+// Predicates that the reads must pass before matching
+sff_filter_options filter_opts = { 0, 0, 0 };
+
+// Number of reads rejected by each filter predicate
+uint32_t nreads_filtered[FILTER_NUM] = { 0 };
+
 sff_common_header ch;
 
 
 // Number of adapter patterns in the input file
 int num_patterns;
 
+// The adapter patterns
+char ** patterns = NULL;
+
+// Write the reads to the splits as soon as they are classified, 
+// i.e., do not preserve the input order of the reads
+int opt_unordered = 0;
+
+// Pin the threads to the NUMA nodes and classify each chunk 
+// on the node that holds its memory
+int opt_numa = 0;
+
+// Routes the chunks to the nodes when opt_numa is set
+numa_router nr;
+
+// Chrome trace of the pipeline stages (--trace), and the 
+// number of events kept per thread
+char * trace_file = NULL;
+uint32_t trace_nevents = TRACE_DEFAULT_EVENTS;
+
+// Max number of reads in flight between the reader and the splits
+uint32_t reorder_window = DEFAULT_REORDER_WINDOW;
+
+// Census mode: fraction of the reads to sample (0 means no census)
+double census_fraction = 0.0;
+int    census_mode     = CENSUS_MODE_STRIDE;
+
+// Write the splits as block-compressed gzip files
+int opt_compress   = 0;
+int compress_level = BGZF_DEFAULT_LEVEL;
+
+// Serialize the writes to a split when opt_unordered is set
+omp_lock_t split_lock[MAX_NUM_ADAPTERS];
+
 
 /** MAIN **/
 
@@ -63,12 +114,35 @@ int main(int argc, char *argv[]) {
   signal(SIGCHLD, sig_handler);
   signal(SIGPIPE, sig_handler);
 
+#ifdef USE_MPI
+  mpi_split_init(&argc, &argv);
+#endif
     
   process_options(argc, argv);
+
+  if ( census_fraction > 0.0 ) {
+#ifdef USE_MPI
+    // The census reads a small sample: a single rank does it
+    if ( mpi_rank == 0 ) {
+      census_sff_using_adapters(sff_file);
+    }
+    mpi_split_finalize();
+#else
+    census_sff_using_adapters(sff_file);
+#endif
+    return 0;
+  }
   
   split_sff_using_adapters(sff_file);
 
+#ifdef USE_MPI
+  if ( mpi_rank == 0 ) {
+    printf("Completed splitting\n");
+  }
+  mpi_split_finalize();
+#else
   printf("Completed splitting\n");
+#endif
   
   return 0;
 
@@ -114,6 +188,23 @@ help_message() {
     fprintf(stdout, "\t%-20s%-20s\n", "-v", "Program and version information");
     fprintf(stdout, "\t%-20s%-20s\n", "-c", "Ignore clipping limits for adapter match");
     fprintf(stdout, "\t%-20s%-20s\n", "-r", "Dry run: do not write the split sff files");
+    fprintf(stdout, "\t%-20s%-20s\n", "-q <min_qual>", "Trim the 3' end at the first window with mean quality < min_qual");
+    fprintf(stdout, "\t%-20s%-20s %d\n", "-w <window>", "Window size for quality trimming. Default:", TRIM_DEFAULT_WINDOW);
+    fprintf(stdout, "\t%-20s%-20s\n", "-b", "Remove the barcode: clip the read after the matched adapter");
+    fprintf(stdout, "\t%-20s%-20s\n", "-m <min_len>", "Drop reads shorter than min_len bases after trimming");
+    fprintf(stdout, "\t%-20s%-20s\n", "--filter-length <n>", "Skip reads with fewer than n bases, before matching");
+    fprintf(stdout, "\t%-20s%-20s\n", "--filter-qual <q>", "Skip reads whose mean quality is below q, before matching");
+    fprintf(stdout, "\t%-20s%-20s\n", "--filter-homopolymer <n>", "Skip reads with a run of the same base longer than n, before matching");
+    fprintf(stdout, "\t%-20s%-20s\n", "-u, --unordered", "Write the reads as soon as they are classified; the order of the reads in a split may vary between runs");
+    fprintf(stdout, "\t%-20s%-20s\n", "--perf", "Count cycles, instructions, LLC and branch misses, and context switches per stage and thread");
+    fprintf(stdout, "\t%-20s%-20s\n", "--trace <file>", "Write a timeline of the pipeline stages of each thread to file, in the Chrome trace format");
+    fprintf(stdout, "\t%-20s%-20s %d\n", "--trace-events <n>", "Events kept per thread; older events are dropped. Default:", TRACE_DEFAULT_EVENTS);
+    fprintf(stdout, "\t%-20s%-20s\n", "--numa", "Pin the threads to the NUMA nodes and keep each chunk of reads on the node that classifies it");
+    fprintf(stdout, "\t%-20s%-20s %d\n", "-W, --window <n>", "Max number of reads in flight. Default:", DEFAULT_REORDER_WINDOW);
+    fprintf(stdout, "\t%-20s%-20s\n", "-s, --census <f>", "Census: estimate the reads per adapter from a fraction f of the reads; no splits are written");
+    fprintf(stdout, "\t%-20s%-20s\n", "--census-mode <m>", "Census sampling: 'stride' (strided seeks, default) or 'index' (uniform through the read index)");
+    fprintf(stdout, "\t%-20s%-20s\n", "-z, --compress", "Write the splits as block-compressed split_NNN.sff.gz files with a .gzi block index");
+    fprintf(stdout, "\t%-20s%-20s %d\n", "--compress-level <n>", "Compression level, 1 to 9. Default:", BGZF_DEFAULT_LEVEL);
     fprintf(stdout, "\t%-20s%-20s %s\n",
                     "-a <adapter_file>",
                     "Adapter file containing the list of adapters.",
@@ -137,7 +228,24 @@ process_options(int argc, char *argv[]) {
     int index;
     char *opt_a_value = NULL;
 
-    while( (c = getopt(argc, argv, "hvcra:")) != -1 ) {
+    static struct option long_options[] = {
+        { "unordered", no_argument,       NULL, 'u' },
+        { "window",    required_argument, NULL, 'W' },
+        { "census",    required_argument, NULL, 's' },
+        { "census-mode", required_argument, NULL, OPT_CENSUS_MODE },
+        { "compress",  no_argument,       NULL, 'z' },
+        { "compress-level", required_argument, NULL, OPT_COMPRESS_LEVEL },
+        { "filter-length", required_argument, NULL, OPT_FILTER_LENGTH },
+        { "filter-qual",   required_argument, NULL, OPT_FILTER_QUAL },
+        { "filter-homopolymer", required_argument, NULL, OPT_FILTER_HOMOPOLYMER },
+        { "numa",      no_argument,       NULL, OPT_NUMA },
+        { "perf",      no_argument,       NULL, OPT_PERF },
+        { "trace",     required_argument, NULL, OPT_TRACE },
+        { "trace-events", required_argument, NULL, OPT_TRACE_EVENTS },
+        { NULL,        0,                 NULL,  0  }
+    };
+
+    while( (c = getopt_long(argc, argv, "hvcra:q:w:bm:uW:s:z", long_options, NULL)) != -1 ) {
         switch(c) {
             case 'h':
                 help_message();
@@ -156,6 +264,90 @@ process_options(int argc, char *argv[]) {
             case 'a':
                 opt_a_value = optarg;
                 break;
+            case 'q':
+                trim_opts.qual_threshold = atoi(optarg);
+                break;
+            case 'w':
+                trim_opts.qual_window = atoi(optarg);
+                if ( trim_opts.qual_window <= 0 ) {
+                    fprintf(stderr, "[err] The quality window size must be positive\n");
+                    exit(1);
+                }
+                break;
+            case 'b':
+                trim_opts.remove_barcode = 1;
+                break;
+            case 'm':
+                trim_opts.min_length = atoi(optarg);
+                break;
+            case 'u':
+                opt_unordered = 1;
+                break;
+            case 'W':
+                reorder_window = (uint32_t) atoi(optarg);
+                if ( reorder_window < READ_CHUNK_SIZE ) {
+                    fprintf(stderr, "[err] The window must hold at least %d reads\n", READ_CHUNK_SIZE);
+                    exit(1);
+                }
+                break;
+            case 's':
+                census_fraction = atof(optarg);
+                if ( census_fraction <= 0.0 || census_fraction > 1.0 ) {
+                    fprintf(stderr, "[err] The census fraction must be in (0, 1]\n");
+                    exit(1);
+                }
+                break;
+            case OPT_CENSUS_MODE:
+                if ( strcmp(optarg, "stride") == 0 ) {
+                    census_mode = CENSUS_MODE_STRIDE;
+                }
+                else if ( strcmp(optarg, "index") == 0 ) {
+                    census_mode = CENSUS_MODE_INDEX;
+                }
+                else {
+                    fprintf(stderr, "[err] Unknown census mode '%s'\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'z':
+#ifdef USE_MPI
+                fprintf(stderr, "[err] Compressed splits are not supported by the MPI version\n");
+                exit(1);
+#endif
+                opt_compress = 1;
+                break;
+            case OPT_COMPRESS_LEVEL:
+                compress_level = atoi(optarg);
+                if ( compress_level < 1 || compress_level > 9 ) {
+                    fprintf(stderr, "[err] The compression level must be in 1..9\n");
+                    exit(1);
+                }
+                break;
+            case OPT_FILTER_LENGTH:
+                filter_opts.min_length = atoi(optarg);
+                break;
+            case OPT_FILTER_QUAL:
+                filter_opts.min_mean_qual = atoi(optarg);
+                break;
+            case OPT_FILTER_HOMOPOLYMER:
+                filter_opts.max_homopolymer = atoi(optarg);
+                break;
+            case OPT_NUMA:
+                opt_numa = 1;
+                break;
+            case OPT_PERF:
+                perf_enabled = 1;
+                break;
+            case OPT_TRACE:
+                trace_file = optarg;
+                break;
+            case OPT_TRACE_EVENTS:
+                trace_nevents = atoi(optarg);
+                if ( trace_nevents < 2 ) {
+                    fprintf(stderr, "[err] The number of trace events must be at least 2\n");
+                    exit(1);
+                }
+                break;
             case '?':
                 exit(1);
              default:
@@ -196,6 +388,28 @@ process_options(int argc, char *argv[]) {
 
 
 
+//
+// Estimate the number of reads per adapter from a sample 
+// of the reads, without writing the split files
+//
+
+void 
+census_sff_using_adapters(char *sff_file) 
+{
+
+    num_patterns = get_patterns(ad_file, &patterns);
+    if ( num_patterns == 0 ) {
+        fprintf(stderr, "[err] No adapters found in '%s'\n", ad_file);
+        exit(1);
+    }
+
+    census_sff(sff_file, patterns, num_patterns, 
+	       census_fraction, census_mode, opt_no_clipping);
+
+} // census_sff_using_adapters()
+
+
+
 //
 // Read sff and split it according to a set of adapters
 //
@@ -205,9 +419,9 @@ split_sff_using_adapters(char *sff_file)
 {
 
     //sff_common_header ch;
-    sff_read_header     rh;
-    sff_read_data       rd;
+    reorder_buffer      rb;
     FILE  *         sff_fp;
+    off_t           data_start, data_end, data_pos;
 
     register int i, pat_idx;
 
@@ -233,7 +447,6 @@ split_sff_using_adapters(char *sff_file)
     //
     // 1.2 Get the list of adapter sequences from the adapter file
     //
-    char **patterns  = NULL;
     num_patterns = get_patterns(ad_file, &patterns);
     fprintf_(stderr, "  Size of patterns[] arr  :  %d\n" , num_patterns);
 
@@ -254,35 +467,19 @@ split_sff_using_adapters(char *sff_file)
 	exit(1);
     }
 
+    nreads_short_split = malloc ( num_patterns * sizeof(uint32_t) );
+    if ( nreads_short_split == NULL ) {
+	fprintf(stderr, "Could not allocate memory for nreads_short_split[%d] array \n", num_patterns);
+	exit(1);
+    }
 
 
-    //
-    // 1.4 Initialize arrays nreads_split_file[] and sff_split_file[]
-    //
-    init_split_file_arrays(num_patterns);
-
-
-    //
-    // 1.5 Build split for each adapter
-    //
 
     //
-    // 1.5 Open the sff split files
+    // 1.4 Initialize arrays nreads_split_file[], nreads_short_split[] 
+    //     and sff_split_file[]
     //
-    if ( ! dry_run ) {
-
-      for (pat_idx = 0; pat_idx < num_patterns; pat_idx++ ) {
-
-	sff_split_fp[pat_idx] = fopen(sff_split_file[pat_idx], "w");    
-	if ( sff_split_fp[pat_idx] == NULL ) {
-	  fprintf(stderr,
-		  "[err] Could not open file '%s' for wrting the split sff number %d.\n",
-		  sff_split_file[pat_idx], pat_idx);
-	  exit(1);
-	}
-      }
-
-    }
+    init_split_file_arrays(num_patterns);
 
 
     //
@@ -321,81 +518,206 @@ split_sff_using_adapters(char *sff_file)
     fprintf_(stderr, "\n");
 
 
+    //
+    // 2.1 The reads occupy the bytes [data_start, data_end) of 
+    //     the file; with MPI, each rank processes the reads in 
+    //     a sub-range of these bytes. The split files have no 
+    //     index section, so their headers say so.
+    //
+    sff_data_range(sff_fp, &ch, &data_start, &data_end);
+    ch.index_offset = 0;
+    ch.index_len    = 0;
+
+#ifdef USE_MPI
+    mpi_split_range(sff_fp, &ch, data_start, data_end, &data_start, &data_end);
+#endif
+
+    fseeko(sff_fp, data_start, SEEK_SET);
+    data_pos = data_start;
+
 
     //
-    // 3. Process each read (header + data)
+    // 2.2 Open the sff split files and write the common 
+    //     header to them; the number of reads is updated 
+    //     when the splits are finalized
     //
+    if ( ! dry_run ) {
 
-    // DEBUG
-    //for (i = 0; i < min(20000, ch.nreads); i++) {
-    for (i = 0; i < ch.nreads; i++) {
-
-      int left_clip = 0, right_clip = 0, nbases = 0;
-
-      fprintf_(stderr, "\n\nProcess read number %d\n" , i);
-
-
-      //
-      // 3.1 Process read header
-      //
-      read_sff_read_header(sff_fp, &rh);
-      
-      fprintf_(stderr, "Read header:\n");
-      fprintf_(stderr, "\theader_len        : %d\n", rh.header_len);
-      fprintf_(stderr, "\tname_len          : %d\n", rh.name_len);
-      fprintf_(stderr, "\tnum_bases         : %d\n", rh.nbases);
-      fprintf_(stderr, "\tclip_qual_left    : %d\n", rh.clip_qual_left);
-      fprintf_(stderr, "\tclip_qual_right   : %d\n", rh.clip_qual_right);
-      fprintf_(stderr, "\tclip_adapter_left : %d\n", rh.clip_adapter_left);
-      fprintf_(stderr, "\tclip_adapter_right: %d\n", rh.clip_adapter_right);
-      
-      
-      // Convert rh.name (name of the read) to null-terminated string
-      str = strndup(rh.name, rh.name_len);
-      if (! str ) {
-	fprintf(stderr, "Out of memory! For read name string!\n");
-	exit(1);
+      for (pat_idx = 0; pat_idx < num_patterns; pat_idx++ ) {
+
+	char * split_name = sff_split_file[pat_idx];
+#ifdef USE_MPI
+	// Each rank writes its reads to a shard of the split
+	split_name = sff_shard_file[pat_idx] = mpi_shard_name(sff_split_file[pat_idx]);
+#endif
+
+	if ( opt_compress ) {
+	  sff_split_fp[pat_idx] = bgzf_open_sff(split_name, &ch, compress_level);
+	}
+	else {
+	  sff_split_fp[pat_idx] = fopen(split_name, "w");    
+	}
+	if ( sff_split_fp[pat_idx] == NULL ) {
+	  fprintf(stderr,
+		  "[err] Could not open file '%s' for wrting the split sff number %d.\n",
+		  split_name, pat_idx);
+	  exit(1);
+	}
+
+	if ( ! opt_compress ) {
+	  write_sff_common_header(sff_split_fp[pat_idx], &ch);
+	}
       }
-      fprintf_(stderr, "\tname              : %s\n", str);
-      free(str);
 
+    }
 
-      //
-      // 3.2 Get the data for this read
-      //
-      fprintf_(stderr, "\nRead data:\n");
 
-      // Fill in the rd structure with the data for this read
-      read_sff_read_data(sff_fp, &rd, ch.flow_len, rh.nbases, i);
 
-      
 
-      //
-      // 3.3 Match the bases in this read against the adapter
-      //     pattern defined by the "pattern" string and 
-      //     write the read to the appropriate sff split
-      //
 
-#pragma omp parallel for \
-  schedule(static,8)     \
-  shared(nreads_split_file, patterns, sff_fp, sff_split_fp, ch, rh, rd, i, dry_run) 
+    //
+    // 3. Process the reads (header + data) in chunks of 
+    //    READ_CHUNK_SIZE consecutive reads: the master thread 
+    //    reads the chunks, and each chunk is classified by a 
+    //    task. Unless opt_unordered is set, the classified 
+    //    chunks go through the reorder stage so that each split 
+    //    receives its reads in input order regardless of 
+    //    the number of threads.
+    //
+    reorder_init(&rb, reorder_window / READ_CHUNK_SIZE, READ_CHUNK_SIZE);
+
+    if ( opt_numa ) {
+      numa_init(&numa_topo);
+      numa_router_init(&nr, omp_get_max_threads());
+    }
+
+    if ( perf_enabled ) {
+      perf_init(omp_get_max_threads());
+    }
+
+    if ( trace_file != NULL ) {
+      trace_init(omp_get_max_threads(), trace_nevents);
+    }
+
+    if ( opt_unordered ) {
       for (pat_idx = 0; pat_idx < num_patterns; pat_idx++ ) {
+	omp_init_lock( &split_lock[pat_idx] );
+      }
+    }
+
+#pragma omp parallel shared(rb, ch, sff_fp, nr)
+    {
+
+    //
+    // 3.0 With opt_numa, pin each thread to a CPU of its node 
+    //     before the reader deals the chunks to the nodes
+    //
+    if ( opt_numa ) {
+      nr.thread_node[omp_get_thread_num()] = 
+	numa_pin_thread(&numa_topo, omp_get_thread_num(), omp_get_num_threads());
+    }
+#pragma omp barrier
+
+#pragma omp single
+    {
+      uint32_t in_flight = 0;
+      uint32_t chunk_num = 0;
+
+      for (i = 0; i < ch.nreads && data_pos < data_end; ) {
+
+	sff_read_chunk * chunk;
+	uint32_t n = min(READ_CHUNK_SIZE, ch.nreads - i);
+
+	fprintf_(stderr, "\n\nProcess reads %d to %d\n" , i, i + n - 1);
+
+
+	//
+	// 3.1 Bound the number of chunks in flight, so that 
+	//     the memory used does not depend on the input size
+	//
+	if ( opt_unordered ) {
+	  if ( in_flight == rb.nslots ) {
+	    TRACE_BEGIN(TRACE_WAIT, i);
+#pragma omp taskwait
+	    TRACE_END(TRACE_WAIT, i);
+	    in_flight = 0;
+	  }
+	  in_flight++;
+	}
+	else if ( ! reorder_has_room(&rb, i) ) {
+	  reorder_drain(&rb, emit_chunk);
+	  if ( ! reorder_has_room(&rb, i) ) {
+	    TRACE_BEGIN(TRACE_WAIT, i);
+#pragma omp taskwait
+	    TRACE_END(TRACE_WAIT, i);
+	    reorder_drain(&rb, emit_chunk);
+	  }
+	}
+
+
+	//
+	// 3.2 Read the headers and data of the reads in this chunk
+	//
+	PERF_BEGIN(PERF_READ);
+	TRACE_BEGIN(TRACE_READ, i);
+	chunk = read_chunk(sff_fp, i, n, data_end, &data_pos, 
+			   opt_numa ? numa_chunk_node(&nr, chunk_num) : 0);
+	TRACE_END(TRACE_READ, i);
+	PERF_END();
+	i += chunk->nreads;
+	chunk_num++;
+
+	if ( opt_numa ) {
+	  numa_router_put(&nr, chunk);
+	}
+
+
+	//
+	// 3.3 Match the bases of each read in this chunk against 
+	//     the adapter patterns and write the read to the 
+	//     splits of the patterns it matches
+	//
+#pragma omp task firstprivate(chunk) shared(rb, nr)
+	{
+	  if ( opt_numa ) {
+	    chunk = numa_router_take(&nr);
+	  }
+
+	  PERF_BEGIN(PERF_CLASSIFY);
+	  TRACE_BEGIN(TRACE_CLASSIFY, chunk->first_read);
+	  classify_chunk(chunk);
+	  TRACE_END(TRACE_CLASSIFY, chunk->first_read);
+	  PERF_END();
+
+	  if ( opt_unordered ) {
+	    emit_chunk_unordered(chunk);
+	    free_read_chunk(chunk);
+	  }
+	  else {
+	    reorder_put(&rb, chunk);
+	    reorder_drain(&rb, emit_chunk);
+	  }
+	}
 
-	match_read_pattern(&ch, &rh, &rd, patterns[pat_idx], pat_idx, 
-			   sff_fp,  sff_split_fp, nreads_split_file, 
-			   i, opt_no_clipping, dry_run);
+      } // for (i = 0; i < ch.numreads; ) { ... }
 
+#pragma omp taskwait
+      if ( ! opt_unordered ) {
+	reorder_drain(&rb, emit_chunk);
       }
-      
 
-      
-      //
-      // 3.5 Free dynamic memory allocated for this read
-      //
-      free_sff_read_header(&rh);
-      free_sff_read_data(&rd);
+    } // omp single
 
-    } // for (i = 0; i < ch.numreads; ) { ... }
+    } // omp parallel
+
+    reorder_free(&rb);
+    free_chunk_pool();
+
+    if ( opt_unordered ) {
+      for (pat_idx = 0; pat_idx < num_patterns; pat_idx++ ) {
+	omp_destroy_lock( &split_lock[pat_idx] );
+      }
+    }
     
 
 
@@ -404,9 +726,64 @@ split_sff_using_adapters(char *sff_file)
     //
 
     if ( ! dry_run ) {
+      PERF_BEGIN(PERF_WRITE);
       for (pat_idx = 0; pat_idx < num_patterns; pat_idx++ ) {
+	TRACE_BEGIN(TRACE_FLUSH, pat_idx);
 	finalize_file_write ( pat_idx ); 
+	TRACE_END(TRACE_FLUSH, pat_idx);
       }
+      PERF_END();
+    }
+
+#ifdef USE_MPI
+    //
+    // 4.1 Sum the read counts over the ranks and assemble 
+    //     the shards into the split files
+    //
+    mpi_split_reduce(i, &ch, num_patterns, nreads_split_file, nreads_short_split, 
+		     nreads_filtered, FILTER_NUM);
+
+    if ( perf_enabled ) {
+      int ncounts;
+      uint64_t * counts = perf_counts(&ncounts);
+      mpi_perf_reduce(counts, ncounts);
+    }
+
+    if ( ! dry_run ) {
+      mpi_split_assemble(&ch, num_patterns, sff_split_file, sff_shard_file, nreads_split_file);
+    }
+
+#endif
+
+    //
+    // 4.2 Report the reads filtered out or dropped
+    //
+#ifdef USE_MPI
+    if ( mpi_rank == 0 )
+#endif
+    print_split_summary();
+
+    if ( opt_numa ) {
+      numa_router_report(&nr);
+      numa_router_free(&nr);
+    }
+
+    if ( perf_enabled ) {
+      perf_free();
+    }
+
+    //
+    // 4.3 Write the timeline of the stages
+    //
+    if ( trace_file != NULL ) {
+#ifdef USE_MPI
+      char rank_file[FILENAME_MAX];
+      snprintf(rank_file, sizeof(rank_file), "%s.rank%d", trace_file, mpi_rank);
+      trace_dump(rank_file, mpi_rank);
+#else
+      trace_dump(trace_file, 0);
+#endif
+      trace_free();
     }
 
 
@@ -424,6 +801,49 @@ split_sff_using_adapters(char *sff_file)
 
 
 
+//
+// Print the number of reads rejected by each filter 
+// predicate, dropped by the trimming policies, and the 
+// performance counts of the stages
+//
+void 
+print_split_summary(void) 
+{
+
+  int pat_idx;
+
+  if ( filter_enabled(&filter_opts) ) {
+    printf("Filtered out %u reads before matching: %u shorter than %d bases, "
+	   "%u with mean quality below %d, %u with a homopolymer longer than %d\n", 
+	   nreads_filtered[FILTER_LENGTH] + nreads_filtered[FILTER_QUALITY] + nreads_filtered[FILTER_HOMOPOLYMER], 
+	   nreads_filtered[FILTER_LENGTH],      filter_opts.min_length, 
+	   nreads_filtered[FILTER_QUALITY],     filter_opts.min_mean_qual, 
+	   nreads_filtered[FILTER_HOMOPOLYMER], filter_opts.max_homopolymer);
+  }
+
+  if ( trim_enabled(&trim_opts) ) {
+    uint32_t nreads_short = 0;
+    for (pat_idx = 0; pat_idx < num_patterns; pat_idx++ ) {
+      nreads_short += nreads_short_split[pat_idx];
+    }
+    if ( trim_opts.min_length > 0 ) {
+      printf("Dropped %u matching reads shorter than %d bases after trimming\n", 
+	     nreads_short, trim_opts.min_length);
+    }
+    else if ( nreads_short > 0 ) {
+      printf("Dropped %u matching reads with no bases left after trimming\n", nreads_short);
+    }
+  }
+
+  if ( perf_enabled ) {
+    perf_report();
+  }
+
+} // print_split_summary()
+
+
+
+
 //
 // Set up the list of names of the split files in
 // 
@@ -442,6 +862,7 @@ init_split_file_arrays( int num_patterns )
     // Reset number of of matching reads for each pattern
     //
     nreads_split_file[pat_idx] = 0;
+    nreads_short_split[pat_idx] = 0;
     
     //
     // Set the names of the split file 
@@ -449,7 +870,7 @@ init_split_file_arrays( int num_patterns )
     //
     
     char template[] = "split_XXX.sff";
-    size_t sz = 1 + strlen(template);
+    size_t sz = 1 + strlen(template) + strlen(BGZF_SUFFIX);
     
     str = malloc( sz * sizeof(char));
     if ( ! str ) {
@@ -465,6 +886,10 @@ init_split_file_arrays( int num_patterns )
     p[0] = code[0]; 
     p[1] = code[1]; 
     p[2] = code[2];
+
+    if ( opt_compress ) {
+      strcat(str, BGZF_SUFFIX);
+    }
 	
     sff_split_file[pat_idx] = str;
     
@@ -521,3 +946,158 @@ finalize_file_write ( int pat_idx )
 
 
 
+
+
+
+
+//
+// Read the headers and data of up to n consecutive reads, 
+// starting with read number first_read at the file offset 
+// *data_pos, and stopping at the offset data_end. Advance 
+// *data_pos past the reads read.
+//
+sff_read_chunk * 
+read_chunk ( FILE * sff_fp, uint32_t first_read, uint32_t n, off_t data_end, off_t * data_pos, int node ) 
+{
+
+  uint32_t k;
+  sff_read_chunk * chunk = alloc_read_chunk(first_read, n, node);
+
+  // A new chunk places its arena blocks on its NUMA node
+  if ( opt_numa && chunk->arena.head == NULL ) {
+    arena_set_node(&(chunk->arena), node, numa_bind_memory);
+  }
+
+  for (k = 0; k < n && *data_pos < data_end; k++) {
+
+    sff_split_read * sr = &(chunk->reads[k]);
+
+    sr->read_num = first_read + k;
+
+    read_sff_read_record(sff_fp, &(sr->rh), &(sr->rd), ch.flow_len, &(chunk->arena));
+
+    *data_pos += sr->rh.header_len + sff_read_data_size(&ch, sr->rh.nbases);
+
+  }
+
+  chunk->nreads = k;
+
+  return chunk;
+
+} // read_chunk()
+
+
+
+//
+// Match each read in the chunk against all the patterns 
+// and record the splits that the read goes to
+//
+void 
+classify_chunk ( sff_read_chunk * chunk ) 
+{
+
+  uint32_t k;
+  int pat_idx, pos;
+  sff_read_header rh_trim;
+
+  for (k = 0; k < chunk->nreads; k++) {
+
+    sff_split_read * sr = &(chunk->reads[k]);
+
+    //
+    // Skip the reads rejected by a filter predicate: they 
+    // have no hits, so they are not written to any split
+    //
+    if ( filter_enabled(&filter_opts) ) {
+      int reason = filter_read(&filter_opts, &(sr->rh), &(sr->rd));
+      if ( reason != FILTER_PASS ) {
+#pragma omp atomic
+	nreads_filtered[reason]++;
+	continue;
+      }
+    }
+
+    for (pat_idx = 0; pat_idx < num_patterns; pat_idx++ ) {
+
+      int rc = match_read_pattern(&ch, &(sr->rh), &(sr->rd), patterns, pat_idx, 
+				  sr->read_num, opt_no_clipping, &trim_opts, &rh_trim, &pos);
+
+      if ( rc == READ_MATCH ) {
+	add_read_hit(chunk, sr, pat_idx, &rh_trim);
+      }
+      else if ( rc == READ_TOO_SHORT ) {
+#pragma omp atomic
+	nreads_short_split[pat_idx]++;
+      }
+    }
+  }
+
+} // classify_chunk()
+
+
+
+//
+// Write the reads of a classified chunk to their splits. 
+// Called by the reorder stage, one chunk at a time, in 
+// increasing order of the read numbers.
+//
+void 
+emit_chunk ( sff_read_chunk * chunk ) 
+{
+
+  uint32_t k;
+  int h;
+
+  PERF_BEGIN(PERF_WRITE);
+  TRACE_BEGIN(TRACE_WRITE, chunk->first_read);
+
+  for (k = 0; k < chunk->nreads; k++) {
+
+    sff_split_read * sr = &(chunk->reads[k]);
+
+    for (h = 0; h < sr->nhits; h++) {
+      write_split_read(&ch, &(sr->hits[h].rh_trim), &(sr->rd), sr->hits[h].pat_idx, 
+		       sff_split_fp, nreads_split_file, sr->read_num, dry_run);
+    }
+  }
+
+  TRACE_END(TRACE_WRITE, chunk->first_read);
+  PERF_END();
+
+} // emit_chunk()
+
+
+
+//
+// Write the reads of a classified chunk to their splits, 
+// locking each split for the duration of a read write
+//
+void 
+emit_chunk_unordered ( sff_read_chunk * chunk ) 
+{
+
+  uint32_t k;
+  int h;
+
+  PERF_BEGIN(PERF_WRITE);
+  TRACE_BEGIN(TRACE_WRITE, chunk->first_read);
+
+  for (k = 0; k < chunk->nreads; k++) {
+
+    sff_split_read * sr = &(chunk->reads[k]);
+
+    for (h = 0; h < sr->nhits; h++) {
+
+      int pat_idx = sr->hits[h].pat_idx;
+
+      omp_set_lock( &split_lock[pat_idx] );
+      write_split_read(&ch, &(sr->hits[h].rh_trim), &(sr->rd), pat_idx, 
+		       sff_split_fp, nreads_split_file, sr->read_num, dry_run);
+      omp_unset_lock( &split_lock[pat_idx] );
+    }
+  }
+
+  TRACE_END(TRACE_WRITE, chunk->first_read);
+  PERF_END();
+
+} // emit_chunk_unordered()
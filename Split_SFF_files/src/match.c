@@ -18,23 +18,37 @@
 
 
 
+// The matcher for the patterns returned by get_patterns()
+pattern_matcher matcher = { 0, "generic", NULL, NULL };
+
+
+// 1 + the 2-bit code of each base; 0 for the other characters
+static const uint8_t base_code[256] = { ['A'] = 1, ['C'] = 2, ['G'] = 3, ['T'] = 4 };
+
+
+
 //
 // Match the pattern passed as argument against the bases 
-// present in the read in the rd structure, then 
-// insert the read in the appropriate split
+// present in the read in the rd structure. If the read 
+// matches, fill in rh_trim with the read header to write 
+// to the split of the pattern, and match_pos with the 0-based 
+// index in the read of the first base of the pattern.
+//
+// Return READ_NO_MATCH, READ_MATCH, or READ_TOO_SHORT if the 
+// read matches but is too short after trimming, or has no 
+// bases left.
 //
-void match_read_pattern (	  
+int match_read_pattern (	  
 	    sff_common_header * ch, 
 	    sff_read_header   * rh, 
 	    sff_read_data     * rd, 
-	    char              * pattern, 
-            int                 pat_idx, 
-	    FILE              * sff_fp, 
-            FILE             ** sff_split_fp, 
-	    uint32_t          * nreads_split_file, 
+	    char             ** patterns, 
+	    int                 pat_idx, 
 	    uint32_t            read_num, 
 	    int                 opt_no_clipping, 
-	    int                 dry_run
+	    sff_trim_options  * trim, 
+	    sff_read_header   * rh_trim, 
+	    int               * match_pos
 ) 
 {     
 
@@ -49,8 +63,10 @@ void match_read_pattern (
       // Match against complete sequence if opt_no_clipping == 1 
       // i.e., if the -c command option is given
       //
+      char * pattern = patterns[pat_idx];
       int left = 0;
       int right = rh->nbases; 
+      int pos, pat_len;
       fprintf_m(stderr, "Matching read number %d with pattern %s\n", read_num, pattern);
 
 
@@ -90,60 +106,102 @@ void match_read_pattern (
       }
       
       
-      //
-      // 1.2 Extract from the bases sequence the subsequence in which 
-      //     to look for the adapter pattern
-      //
-      char * text = get_read_bases(rd, left, right);
-      fprintf_m(stderr, "\t text[%-4d:%-4d] :     %s\n", left,      right-1, text);
-      fprintf_m(stderr, "\t pattern         :     %s\n", pattern);
-      //fprintf_m(stderr, "\tbases[%-4d:%-4d]  : %s\n",  left_clip, right_clip-1, bases);
+      if ( matcher.kernel != NULL && left >= 0 && left <= right && right <= rh->nbases ) {
+
+	//
+	// 1.2 / 2. The patterns have a specialized matcher, which 
+	//          scans the bases of the read in place
+	//
+	fprintf_m(stderr, "\t text[%-4d:%-4d] :     %.*s\n", left, right-1, right - left, rd->bases + left);
+	pos = matcher.kernel(rd->bases + left, right - left, matcher.packed[pat_idx]);
+	pat_len = matcher.len;
+      }
+      else {
+
+	//
+	// 1.2 Extract from the bases sequence the subsequence in which 
+	//     to look for the adapter pattern
+	//
+	char * text = get_read_bases(rd, left, right);
+	fprintf_m(stderr, "\t text[%-4d:%-4d] :     %s\n", left,      right-1, text);
+	fprintf_m(stderr, "\t pattern         :     %s\n", pattern);
+	//fprintf_m(stderr, "\tbases[%-4d:%-4d]  : %s\n",  left_clip, right_clip-1, bases);
       
       
       
-      //
-      // 2. Match pattern against text
-      //
-      int pos = match(text, pattern);
-      free(text);
+	//
+	// 2. Match pattern against text
+	//
+	pos = match(text, pattern);
+	free(text);
+	pat_len = strlen(pattern);
+      }
 
       if( pos == -1 ) {
-	fprintf_m(stderr, "\tDid NOT find pattern %s in text %s\n", pattern, text);
-	return;
+	fprintf_m(stderr, "\tDid NOT find pattern %s in read %d\n", pattern, read_num);
+	return READ_NO_MATCH;
       }
 
-      
+            
+      fprintf_m(stderr, "\tFound pattern %s in read %d at index %d\n", pattern, read_num, pos);
+
+      *match_pos = left + pos;
+
       //
-      // 3. Found a match for this read; so write this read 
-      //    to the split file if this is not a dry-run
+      // 3. Found a match for this read; apply the trimming 
+      //    policies, if any, and reject the read if it is 
+      //    too short after trimming
       //
-            
-      fprintf_m(stderr, "\tFound pattern %s in text %s at index %d\n", pattern, text, pos);
+      *rh_trim = *rh;
+
+      if ( trim_enabled(trim) ) {
+
+	int barcode_end = left + pos + pat_len;
+	int trim_len = trim_read_header(rh_trim, rh, rd, trim, barcode_end);
+
+	if ( trim_len == 0 || trim_len < trim->min_length ) {
+	  fprintf_m(stderr, "\tRead %d has %d bases after trimming; skip it\n", read_num, trim_len);
+	  return READ_TOO_SHORT;
+	}
+      }
+
+      return READ_MATCH;
+
+} // match_read_pattern()
+
+
+
+
+//
+// Write a read that matched the pattern pat_idx to the 
+// split file of that pattern, unless this is a dry-run
+//
+void write_split_read (	  
+	    sff_common_header * ch, 
+	    sff_read_header   * rh, 
+	    sff_read_data     * rd, 
+            int                 pat_idx, 
+            FILE             ** sff_split_fp, 
+	    uint32_t          * nreads_split_file, 
+	    uint32_t            read_num, 
+	    int                 dry_run
+) 
+{     
 
       nreads_split_file[pat_idx] += 1;
       
       if ( ! dry_run ) {
 	
 	//
-	// 3.1 For the first write, write the common header
-	//	
-	if ( nreads_split_file[pat_idx] == 1 ) {
-	  
-	  fprintf_m(stderr, "\nWrite common header for split %d\n", pat_idx);  
-	  write_sff_common_header(sff_split_fp[pat_idx], ch);  
-	    
-	}
-	  
-	
-	//
-	// 3.2 Write the read header for this read
+	// 1. Write the (possibly trimmed) read header for this read. 
+	//    The common header was written when the split was opened.
 	//	
 	fprintf_m(stderr, "Write read header for read number %d\n", read_num);   
 	write_sff_read_header(sff_split_fp[pat_idx], rh);  
 	
 	
 	//
-	// 3.3 Write the data for this read
+	// 2. Write the data for this read
 	//
 	fprintf_m(stderr, "Write data for read number %d\n", read_num);	  
 	write_sff_read_data(sff_split_fp[pat_idx], rd, ch->flow_len, rh->nbases, read_num);
@@ -152,7 +210,7 @@ void match_read_pattern (
       } // if ( ! dry_run ) { ... }
 
 
-} // match_read_pattern()
+} // write_split_read()
 
 
 
@@ -185,9 +243,7 @@ int match(char text[], char pattern[]) {
     // Start pos in text
     text_idx = text_pos;
 
-    char * substr = strdup( &text[text_idx] ); 
-    fprintf_m(stderr, "\tMatching substring text[%d]=%s with pattern=%s\n", text_idx, substr, pattern);
-    free(substr);
+    fprintf_m(stderr, "\tMatching substring text[%d]=%s with pattern=%s\n", text_idx, &text[text_idx], pattern);
 
  
     // Compare text[text_pos:text_pos+text_len-1] with text[0:text_len-1]
@@ -220,6 +276,131 @@ int match(char text[], char pattern[]) {
 
 
 
+//
+// Matchers specialized on the length L of the patterns: the 
+// pattern is packed in a word, 2 bits per base, and the last 
+// L bases of the text are kept packed in a word the same way, 
+// so matching at a position is one comparison. run counts the 
+// bases since the last character that is not A, C, G or T, 
+// which cannot be part of a match.
+//
+#define DEFINE_MATCH_PACKED(L)						\
+static int match_packed_##L (const char * text, int text_len, uint32_t packed) \
+{									\
+  const uint32_t mask = (uint32_t) ( ( (uint64_t) 1 << (2 * L) ) - 1 );	\
+  uint32_t word = 0;							\
+  int i, run = 0;							\
+									\
+  for (i = 0; i < text_len; i++) {					\
+    int code = base_code[ (unsigned char) text[i] ];			\
+    word = ( (word << 2) | ( (code - 1) & 3 ) ) & mask;		\
+    run  = code ? run + 1 : 0;						\
+    if ( run >= L && word == packed ) {					\
+      return i - L + 1;							\
+    }									\
+  }									\
+									\
+  return -1;								\
+}
+
+DEFINE_MATCH_PACKED(6)
+DEFINE_MATCH_PACKED(8)
+DEFINE_MATCH_PACKED(10)
+DEFINE_MATCH_PACKED(12)
+DEFINE_MATCH_PACKED(16)
+
+
+static const struct {
+  int          len;
+  const char * name;
+  int       (* kernel)(const char * text, int text_len, uint32_t packed);
+} packed_matchers[] = {
+  {  6, "packed6",  match_packed_6  },
+  {  8, "packed8",  match_packed_8  },
+  { 10, "packed10", match_packed_10 },
+  { 12, "packed12", match_packed_12 },
+  { 16, "packed16", match_packed_16 }
+};
+
+
+
+//
+// Pick the matcher for the patterns: a packed matcher if all 
+// the patterns have the same length, that length has a packed 
+// matcher, and the patterns have only A, C, G and T; match() 
+// otherwise
+//
+void select_matcher(char ** patterns, int num_patterns) 
+{
+
+  int i, k, len;
+
+  free(matcher.packed);
+  matcher.len    = 0;
+  matcher.name   = "generic";
+  matcher.kernel = NULL;
+  matcher.packed = NULL;
+
+  if ( num_patterns == 0 ) {
+    return;
+  }
+
+
+  //
+  // 1. Check that the patterns have the same length
+  //
+  len = strlen(patterns[0]);
+  for (i = 1; i < num_patterns; i++) {
+    if ( (int) strlen(patterns[i]) != len ) {
+      fprintf_m(stderr, "  Patterns of mixed lengths; use the generic matcher\n");
+      return;
+    }
+  }
+
+
+  //
+  // 2. Pack the patterns
+  //
+  for (k = 0; k < (int) (sizeof(packed_matchers) / sizeof(packed_matchers[0])); k++) {
+    if ( packed_matchers[k].len == len ) {
+      break;
+    }
+  }
+  if ( k == (int) (sizeof(packed_matchers) / sizeof(packed_matchers[0])) ) {
+    return;
+  }
+
+  uint32_t * packed = malloc( num_patterns * sizeof(uint32_t) );
+  if ( ! packed ) {
+    fprintf(stderr, "Out of memory! Could not allocate the packed patterns\n");
+    exit(1);
+  }
+
+  for (i = 0; i < num_patterns; i++) {
+    int j;
+    packed[i] = 0;
+    for (j = 0; j < len; j++) {
+      int code = base_code[ (unsigned char) patterns[i][j] ];
+      if ( code == 0 ) {
+	fprintf_m(stderr, "  Pattern %s is not made of A, C, G, T; use the generic matcher\n", patterns[i]);
+	free(packed);
+	return;
+      }
+      packed[i] = (packed[i] << 2) | (code - 1);
+    }
+  }
+
+  matcher.len    = len;
+  matcher.name   = packed_matchers[k].name;
+  matcher.kernel = packed_matchers[k].kernel;
+  matcher.packed = packed;
+
+  fprintf_m(stderr, "  Use the %s matcher\n", matcher.name);
+
+} // select_matcher()
+
+
+
 //
 // Extract the list of adapters from the adapter file
 // 
@@ -306,6 +487,12 @@ int get_patterns ( char * ad_file, char *** ptr ) {
   fflush(stderr);
 
 
+  //
+  // 2.4 Pick the matcher for the patterns
+  //
+  select_matcher(patterns, num_patterns);
+
+
   /*
   char * patterns[] = {
     "AAGAGGATTC",      // IonXpress_003
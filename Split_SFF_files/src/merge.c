@@ -0,0 +1,440 @@
+/*
+
+  Program to merge (concatenate) a number of SFF files 
+  with compatible common headers into one SFF file. 
+
+  The read records are copied as opaque byte ranges, 
+  in the kernel when possible, so they are not decoded.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#include "merge.h"
+
+
+//
+// The merged file while it is being written; removed 
+// at exit unless the merge completed
+//
+static char * partial_out_file = NULL;
+
+
+
+/** MAIN **/
+
+int main(int argc, char *argv[]) {
+
+  merge_input       inputs[MAX_NUM_INPUTS];
+  int               num_inputs = 0;
+  char            * out_file   = NULL;
+  int               opt_index  = 0;
+  int               c, k;
+  uint64_t          nreads = 0;
+  sff_common_header ch_out;
+  FILE            * out_fp;
+  off_t             out_off, out_data_start;
+
+
+  //
+  // 1. Process the command line
+  //
+  while ( (c = getopt(argc, argv, "hvio:")) != -1 ) {
+    switch(c) {
+      case 'h':
+        merge_help_message();
+        exit(0);
+      case 'v':
+        fprintf(stdout, "%s -- version: %s\n", MERGE_PRG_NAME, MERGE_VERSION);
+        exit(0);
+      case 'i':
+        opt_index = 1;
+        break;
+      case 'o':
+        out_file = optarg;
+        break;
+      default:
+        exit(1);
+    }
+  }
+
+  if ( out_file == NULL || optind >= argc ) {
+    fprintf(stderr, "[err] Need an output file and at least one input file. See '%s -h' for usage!\n", 
+	    MERGE_PRG_NAME);
+    exit(1);
+  }
+
+  if ( argc - optind > MAX_NUM_INPUTS ) {
+    fprintf(stderr, "[err] At most %d input files can be merged\n", MAX_NUM_INPUTS);
+    exit(1);
+  }
+
+
+  //
+  // 2. Read and check the common headers of the inputs
+  //
+  for (k = optind; k < argc; k++, num_inputs++) {
+
+    open_merge_input(&inputs[num_inputs], argv[k]);
+
+    if ( num_inputs > 0 ) {
+      check_compatible_headers(&inputs[0], &inputs[num_inputs]);
+    }
+
+    nreads += inputs[num_inputs].ch.nreads;
+  }
+
+  if ( nreads > UINT32_MAX ) {
+    fprintf(stderr, "[err] The merged file would have %llu reads, more than an SFF file can hold\n", 
+	    (unsigned long long) nreads);
+    exit(1);
+  }
+
+
+  //
+  // 3. Write the common header of the merged file. The index 
+  //    sections of the inputs are not copied, since their 
+  //    offsets are not valid in the merged file.
+  //
+  check_output_file(out_file, inputs, num_inputs);
+
+  if ( (out_fp = fopen(out_file, "w")) == NULL ) {
+    fprintf(stderr, "[err] Could not open file '%s' for writing.\n", out_file);
+    exit(1);
+  }
+
+  partial_out_file = out_file;
+  atexit(remove_partial_output);
+
+  ch_out              = inputs[0].ch;
+  ch_out.nreads       = (uint32_t) nreads;
+  ch_out.index_offset = 0;
+  ch_out.index_len    = 0;
+
+  write_sff_common_header(out_fp, &ch_out);
+  out_data_start = out_off = ftello(out_fp);
+
+
+  //
+  // 4. Copy the read records of each input
+  //
+  for (k = 0; k < num_inputs; k++) {
+
+    off_t len = inputs[k].data_end - inputs[k].data_start;
+
+    fprintf_(stderr, "Copy %lld bytes of reads from '%s'\n", (long long) len, inputs[k].file_name);
+
+    copy_file_region(fileno(inputs[k].fp), inputs[k].data_start, 
+		     fileno(out_fp), out_off, len);
+    out_off += len;
+  }
+
+  if ( fclose(out_fp) != 0 ) {
+    fprintf(stderr, "[err] Could not close '%s': %s\n", out_file, strerror(errno));
+    exit(1);
+  }
+
+
+  //
+  // 5. Rebuild the read index of the merged file from the 
+  //    indexes of the inputs, shifting each input's offsets 
+  //    to where its reads landed in the merged file
+  //
+  if ( opt_index ) {
+
+    off_t  * offsets = malloc( (nreads ? nreads : 1) * sizeof(off_t) );
+    off_t    shift;
+    uint64_t r = 0;
+    uint32_t i;
+    char     idx_file[FILENAME_MAX];
+
+    if ( ! offsets ) {
+      fprintf(stderr, "Out of memory! Could not allocate the read index\n");
+      exit(1);
+    }
+
+    out_off = out_data_start;
+
+    for (k = 0; k < num_inputs; k++) {
+
+      off_t * in_offsets = NULL;
+
+      snprintf(idx_file, sizeof(idx_file), "%s%s", inputs[k].file_name, SFF_INDEX_SUFFIX);
+      if ( ! load_read_index(idx_file, &inputs[k].ch, inputs[k].data_end, &in_offsets) ) {
+	build_read_index(inputs[k].fp, &inputs[k].ch, 
+			 inputs[k].data_start, inputs[k].data_end, &in_offsets);
+      }
+
+      shift = out_off - inputs[k].data_start;
+      for (i = 0; i < inputs[k].ch.nreads; i++) {
+	offsets[r++] = in_offsets[i] + shift;
+      }
+
+      out_off += inputs[k].data_end - inputs[k].data_start;
+      free(in_offsets);
+    }
+
+    snprintf(idx_file, sizeof(idx_file), "%s%s", out_file, SFF_INDEX_SUFFIX);
+    if ( ! save_read_index(idx_file, &ch_out, out_off, offsets) ) {
+      fprintf(stderr, "[err] Could not write the read index '%s'\n", idx_file);
+      exit(1);
+    }
+
+    free(offsets);
+  }
+
+  partial_out_file = NULL;
+
+
+  //
+  // 6. Clean up
+  //
+  for (k = 0; k < num_inputs; k++) {
+    free_sff_common_header(&inputs[k].ch);
+    fclose(inputs[k].fp);
+  }
+
+  printf("Merged %d files with %llu reads into '%s'\n", 
+	 num_inputs, (unsigned long long) nreads, out_file);
+
+  return 0;
+
+} // main()
+
+
+
+/** FUNCTIONS **/
+
+
+void
+merge_help_message() {
+    fprintf(stdout, "Usage: %s %s %s\n", MERGE_PRG_NAME, "[options] -o <out_sff>", "<sff_file> ...");
+    fprintf(stdout, "\t%-20s%-20s\n", "-h", "This help message");
+    fprintf(stdout, "\t%-20s%-20s\n", "-v", "Program and version information");
+    fprintf(stdout, "\t%-20s%-20s\n", "-i", "Also write the read index <out_sff>" SFF_INDEX_SUFFIX);
+    fprintf(stdout, "\t%-20s%-20s %s\n",
+                    "-o <out_sff>",
+                    "Merged SFF file.",
+                    "Must be specified");
+}
+
+
+
+//
+// Open an input file, read its common header, and 
+// locate the byte range that holds its reads
+//
+void 
+open_merge_input(merge_input * in, char * file_name) 
+{
+
+  in->file_name = file_name;
+
+  if ( (in->fp = fopen(file_name, "r")) == NULL ) {
+    fprintf(stderr, "[err] Could not open sff file '%s' for reading.\n", file_name);
+    exit(1);
+  }
+
+  read_sff_common_header(in->fp, &in->ch);
+  verify_sff_common_header(MERGE_PRG_NAME, MERGE_VERSION, &in->ch);
+
+  //
+  // The index section, if any, follows the reads
+  //
+  sff_data_range(in->fp, &in->ch, &in->data_start, &in->data_end);
+
+  if ( in->data_end < in->data_start || 
+       (in->data_end - in->data_start) % PADDING_SIZE != 0 ) {
+    fprintf(stderr, "[err] The reads of '%s' do not end on a record boundary\n", file_name);
+    exit(1);
+  }
+
+} // open_merge_input()
+
+
+
+//
+// The reads of two files can be merged only if they 
+// were produced with the same flows and key
+//
+void 
+check_compatible_headers(merge_input * ref, merge_input * in) 
+{
+
+  if ( ref->ch.flow_len        != in->ch.flow_len        || 
+       ref->ch.key_len         != in->ch.key_len         || 
+       ref->ch.flowgram_format != in->ch.flowgram_format || 
+       ref->ch.header_len      != in->ch.header_len      || 
+       memcmp(ref->ch.flow, in->ch.flow, ref->ch.flow_len) != 0 || 
+       memcmp(ref->ch.key,  in->ch.key,  ref->ch.key_len)  != 0 ) {
+
+    fprintf(stderr, "[err] The flow/key header of '%s' does not match that of '%s'\n", 
+	    in->file_name, ref->file_name);
+    exit(1);
+  }
+
+} // check_compatible_headers()
+
+
+
+//
+// Opening the output truncates it, so it must not be 
+// one of the inputs, under any name
+//
+void 
+check_output_file(char * out_file, merge_input * inputs, int num_inputs) 
+{
+
+  struct stat out_st, in_st;
+  int         k;
+
+  if ( stat(out_file, &out_st) != 0 ) {
+    return;
+  }
+
+  for (k = 0; k < num_inputs; k++) {
+    if ( fstat(fileno(inputs[k].fp), &in_st) == 0 && 
+         in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino ) {
+      fprintf(stderr, "[err] The output file '%s' is the input file '%s'\n", 
+	      out_file, inputs[k].file_name);
+      exit(1);
+    }
+  }
+
+} // check_output_file()
+
+
+
+//
+// Remove the merged file if the program exits before 
+// the merge completed, so no truncated file is left
+//
+void 
+remove_partial_output(void) 
+{
+
+  if ( partial_out_file != NULL ) {
+    unlink(partial_out_file);
+  }
+
+} // remove_partial_output()
+
+
+
+//
+// Copy len bytes from fd_in at off_in to fd_out at off_out. 
+// Use copy_file_range() so the data stays in the kernel (and 
+// may be reflinked by the file system); fall back to sendfile() 
+// and then to read()/write() where that is not supported.
+//
+void 
+copy_file_region(int fd_in, off_t off_in, int fd_out, off_t off_out, off_t len) 
+{
+
+  ssize_t n;
+  int     use_copy_range = 1;
+
+
+  //
+  // 1. copy_file_range(); fails with EXDEV across file systems 
+  //    on older kernels, and with ENOSYS/EINVAL where unsupported
+  //
+  while ( len > 0 && use_copy_range ) {
+
+    n = copy_file_range(fd_in, &off_in, fd_out, &off_out, (size_t) len, 0);
+
+    if ( n > 0 ) {
+      len -= n;
+    }
+    else if ( n < 0 && errno == EINTR ) {
+      continue;
+    }
+    else if ( n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || 
+			errno == EOPNOTSUPP) ) {
+      use_copy_range = 0;
+    }
+    else {
+      fprintf(stderr, "[err] copy_file_range failed: %s\n", n < 0 ? strerror(errno) : "unexpected EOF");
+      exit(1);
+    }
+  }
+
+
+  //
+  // 2. sendfile() writes at the current position of fd_out
+  //
+  if ( len > 0 && lseek(fd_out, off_out, SEEK_SET) == off_out ) {
+
+    while ( len > 0 ) {
+
+      n = sendfile(fd_out, fd_in, &off_in, (size_t) min(len, (off_t) 1 << 30));
+
+      if ( n > 0 ) {
+	len -= n;
+	off_out += n;
+      }
+      else if ( n < 0 && errno == EINTR ) {
+	continue;
+      }
+      else {
+	break;
+      }
+    }
+  }
+
+
+  //
+  // 3. read()/write() through a user-space buffer
+  //
+  if ( len > 0 ) {
+
+    char * buf = malloc(MERGE_COPY_BUF);
+    if ( ! buf ) {
+      fprintf(stderr, "Out of memory! Could not allocate the copy buffer\n");
+      exit(1);
+    }
+
+    while ( len > 0 ) {
+
+      ssize_t r = pread(fd_in, buf, (size_t) min(len, (off_t) MERGE_COPY_BUF), off_in);
+      ssize_t w = 0;
+
+      if ( r <= 0 ) {
+	fprintf(stderr, "[err] Could not read the input: %s\n", r < 0 ? strerror(errno) : "unexpected EOF");
+	exit(1);
+      }
+
+      while ( w < r ) {
+	n = pwrite(fd_out, buf + w, (size_t) (r - w), off_out + w);
+	if ( n < 0 && errno == EINTR ) {
+	  continue;
+	}
+	if ( n <= 0 ) {
+	  fprintf(stderr, "[err] Could not write the output: %s\n", strerror(errno));
+	  exit(1);
+	}
+	w += n;
+      }
+
+      off_in  += r;
+      off_out += r;
+      len     -= r;
+    }
+
+    free(buf);
+  }
+
+} // copy_file_region()
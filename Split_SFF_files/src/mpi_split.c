@@ -0,0 +1,312 @@
+/*
+
+  Sharded splitting of an SFF file across MPI ranks. 
+
+  Each rank splits the reads in a byte range of the input 
+  into per-rank shards; the per-split read counts are 
+  reduced across ranks, and the shards of each split are 
+  assembled into the final split file with MPI-IO at 
+  offsets computed with a prefix sum of the shard sizes.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mpi_split.h"
+
+
+
+/** GLOBALS **/
+
+int mpi_rank = 0;
+int mpi_size = 1;
+
+
+
+/** FUNCTIONS **/
+
+
+void 
+mpi_split_init(int * argc, char *** argv) 
+{
+
+  int provided;
+
+  //
+  // Only the master thread of each rank makes MPI calls, 
+  // outside of the OpenMP parallel regions
+  //
+  MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
+  MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+
+  if ( provided < MPI_THREAD_FUNNELED && mpi_rank == 0 ) {
+    fprintf(stderr, "[warn] The MPI library does not support MPI_THREAD_FUNNELED\n");
+  }
+
+} // mpi_split_init()
+
+
+
+void 
+mpi_split_finalize(void) 
+{
+
+  MPI_Finalize();
+
+} // mpi_split_finalize()
+
+
+
+//
+// Name of the shard of a split written by this rank
+//
+char * 
+mpi_shard_name(char * split_file) 
+{
+
+  size_t sz = strlen(split_file) + 32;
+  char * str = malloc(sz);
+
+  if ( ! str ) {
+    fprintf(stderr, "Cannot allocate memory for split sff shard names\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  snprintf(str, sz, "%s.rank%d", split_file, mpi_rank);
+
+  return str;
+
+} // mpi_shard_name()
+
+
+
+//
+// Assign to each rank a contiguous byte range of the data 
+// section: the ranges start at equally spaced offsets moved 
+// forward to the next read record boundary, so consecutive 
+// ranks get consecutive reads.
+//
+void 
+mpi_split_range(FILE              * fp, 
+                sff_common_header * ch, 
+                off_t               data_start, 
+                off_t               data_end, 
+                off_t             * range_start, 
+                off_t             * range_end) 
+{
+
+  long long   start, *starts;
+  off_t       guess, rec;
+
+  guess = data_start + (data_end - data_start) / mpi_size * mpi_rank;
+  guess -= (guess - data_start) % PADDING_SIZE;
+
+  if ( mpi_rank == 0 ) {
+    start = data_start;
+  }
+  else if ( resync_read_record(fp, ch, guess, data_end, &rec) ) {
+    start = rec;
+  }
+  else {
+    // No record starts in the tail of the data section
+    start = data_end;
+  }
+
+  starts = malloc( mpi_size * sizeof(long long) );
+  if ( ! starts ) {
+    fprintf(stderr, "Out of memory! Could not allocate the rank ranges\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  MPI_Allgather(&start, 1, MPI_LONG_LONG, starts, 1, MPI_LONG_LONG, MPI_COMM_WORLD);
+
+  *range_start = (off_t) start;
+  *range_end   = (mpi_rank == mpi_size - 1) ? data_end : (off_t) starts[mpi_rank + 1];
+
+  fprintf2_(stderr, "Rank %d reads bytes [%lld, %lld)\n", 
+	    mpi_rank, (long long) *range_start, (long long) *range_end);
+
+  free(starts);
+
+} // mpi_split_range()
+
+
+
+//
+// Sum the per-split and per-filter read counts over all ranks, and check 
+// that the ranks together processed every read of the input
+//
+void 
+mpi_split_reduce(uint32_t          nreads_local, 
+                 sff_common_header * ch, 
+                 int               num_patterns, 
+                 uint32_t        * nreads_split_file, 
+                 uint32_t        * nreads_short_split, 
+                 uint32_t        * nreads_filtered, 
+                 int               nfilters) 
+{
+
+  uint32_t nreads_total = 0;
+
+  MPI_Allreduce(&nreads_local, &nreads_total, 1, MPI_UINT32_T, MPI_SUM, MPI_COMM_WORLD);
+
+  if ( nreads_total != ch->nreads ) {
+    if ( mpi_rank == 0 ) {
+      fprintf(stderr, "[err] The ranks processed %u reads, but the file has %u reads\n", 
+	      nreads_total, ch->nreads);
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, nreads_split_file,  num_patterns, MPI_UINT32_T, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, nreads_short_split, num_patterns, MPI_UINT32_T, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, nreads_filtered,    nfilters,     MPI_UINT32_T, MPI_SUM, MPI_COMM_WORLD);
+
+} // mpi_split_reduce()
+
+
+
+//
+// Sum the performance counts of the ranks on rank 0; thread t 
+// of rank 0 gets the sum over the threads t of the ranks
+//
+void 
+mpi_perf_reduce(uint64_t * counts, int n) 
+{
+
+  if ( mpi_rank == 0 ) {
+    MPI_Reduce(MPI_IN_PLACE, counts, n, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+  }
+  else {
+    MPI_Reduce(counts, NULL, n, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+  }
+
+} // mpi_perf_reduce()
+
+
+
+//
+// Assemble the shards of each split into the split file: 
+// rank 0 writes the common header with the total number of 
+// reads, and each rank writes the reads of its shard right 
+// after the reads of the lower ranks. The shards are removed.
+//
+void 
+mpi_split_assemble(sff_common_header * ch, 
+                   int               num_patterns, 
+                   char           ** split_files, 
+                   char           ** shard_files, 
+                   uint32_t        * nreads_split_file) 
+{
+
+  sff_common_header ch_l = *ch;
+  long long * shard_bytes, * shard_offset;
+  char      * hdr_buf, * buf;
+  size_t      hdr_size;
+  FILE      * hdr_fp;
+  int         pat_idx;
+
+
+  //
+  // 1. Serialize the common header in memory to learn its size
+  //
+  hdr_buf = malloc(MPI_ASSEMBLE_BUF);
+  buf     = malloc(MPI_ASSEMBLE_BUF);
+  shard_bytes  = calloc(num_patterns, sizeof(long long));
+  shard_offset = calloc(num_patterns, sizeof(long long));
+  if ( ! hdr_buf || ! buf || ! shard_bytes || ! shard_offset ) {
+    fprintf(stderr, "Out of memory! Could not allocate the assembly buffers\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  hdr_fp = fmemopen(hdr_buf, MPI_ASSEMBLE_BUF, "w");
+  write_sff_common_header(hdr_fp, &ch_l);
+  hdr_size = (size_t) ftell(hdr_fp);
+  fclose(hdr_fp);
+
+
+  //
+  // 2. Offset of this rank's reads in each split: exclusive 
+  //    prefix sum of the sizes of the shards' read sections
+  //
+  for (pat_idx = 0; pat_idx < num_patterns; pat_idx++) {
+
+    FILE * fp = fopen(shard_files[pat_idx], "r");
+    if ( fp == NULL ) {
+      fprintf(stderr, "[err] Could not open shard '%s'\n", shard_files[pat_idx]);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    fseeko(fp, 0, SEEK_END);
+    shard_bytes[pat_idx] = (long long) ftello(fp) - (long long) hdr_size;
+    fclose(fp);
+  }
+
+  MPI_Exscan(shard_bytes, shard_offset, num_patterns, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  if ( mpi_rank == 0 ) {
+    memset(shard_offset, 0, num_patterns * sizeof(long long));
+  }
+
+
+  //
+  // 3. Write each split file collectively
+  //
+  for (pat_idx = 0; pat_idx < num_patterns; pat_idx++) {
+
+    MPI_File   fh;
+    MPI_Status status;
+    long long  total = shard_offset[pat_idx] + shard_bytes[pat_idx];
+    long long  done  = 0;
+    FILE     * fp;
+
+    // The last rank knows the total size of the reads
+    MPI_Bcast(&total, 1, MPI_LONG_LONG, mpi_size - 1, MPI_COMM_WORLD);
+
+    if ( MPI_File_open(MPI_COMM_WORLD, split_files[pat_idx], 
+		       MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS ) {
+      fprintf(stderr, "[err] Could not open '%s' with MPI-IO\n", split_files[pat_idx]);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(fh, (MPI_Offset) (hdr_size + total));
+
+    if ( mpi_rank == 0 ) {
+      ch_l.nreads = nreads_split_file[pat_idx];
+      hdr_fp = fmemopen(hdr_buf, MPI_ASSEMBLE_BUF, "w");
+      write_sff_common_header(hdr_fp, &ch_l);
+      fclose(hdr_fp);
+      MPI_File_write_at(fh, 0, hdr_buf, (int) hdr_size, MPI_BYTE, &status);
+    }
+
+    fp = fopen(shard_files[pat_idx], "r");
+    fseeko(fp, (off_t) hdr_size, SEEK_SET);
+
+    while ( done < shard_bytes[pat_idx] ) {
+      size_t n = fread(buf, 1, (size_t) min(shard_bytes[pat_idx] - done, (long long) MPI_ASSEMBLE_BUF), fp);
+      if ( n == 0 ) {
+	fprintf(stderr, "[err] Could not read shard '%s'\n", shard_files[pat_idx]);
+	MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+      MPI_File_write_at(fh, (MPI_Offset) (hdr_size + shard_offset[pat_idx] + done), 
+			buf, (int) n, MPI_BYTE, &status);
+      done += n;
+    }
+
+    fclose(fp);
+    MPI_File_close(&fh);
+
+    unlink(shard_files[pat_idx]);
+  }
+
+  free(hdr_buf);
+  free(buf);
+  free(shard_bytes);
+  free(shard_offset);
+
+} // mpi_split_assemble()
@@ -0,0 +1,361 @@
+/*
+
+  NUMA placement for the split: the threads are pinned 
+  to the CPUs of the NUMA nodes, the arenas of the chunks 
+  are bound to a node, and each chunk is classified and 
+  written, when possible, by a thread of the node that 
+  holds its memory.
+
+  The topology is read from sysfs and the memory is bound 
+  with the mbind system call, so no NUMA library is needed.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "numa_split.h"
+
+
+#ifndef MPOL_BIND
+  #define MPOL_BIND  2
+#endif
+
+
+
+/** GLOBALS **/
+
+numa_topology numa_topo;
+
+// Node of the CPUs the calling thread is pinned to
+static int thread_node = 0;
+#pragma omp threadprivate(thread_node)
+
+
+
+/** FUNCTIONS **/
+
+
+//
+// Parse a sysfs CPU list such as "0-7,16-23" and add 
+// the CPUs in the allowed set to cpus[]
+//
+static int 
+parse_cpu_list(char * list, cpu_set_t * allowed, int * cpus, int max_cpus) 
+{
+
+  int n = 0;
+  char * tok, * save = NULL;
+
+  for (tok = strtok_r(list, ",\n", &save); tok != NULL; tok = strtok_r(NULL, ",\n", &save)) {
+
+    int lo, hi, c;
+
+    if ( sscanf(tok, "%d-%d", &lo, &hi) != 2 ) {
+      if ( sscanf(tok, "%d", &lo) != 1 ) {
+	continue;
+      }
+      hi = lo;
+    }
+
+    for (c = lo; c <= hi && n < max_cpus; c++) {
+      if ( CPU_ISSET(c, allowed) ) {
+	cpus[n++] = c;
+      }
+    }
+  }
+
+  return n;
+
+} // parse_cpu_list()
+
+
+
+//
+// Find the NUMA nodes with CPUs in the affinity mask of the 
+// process. Without NUMA information, all the CPUs form one node.
+// Return the number of nodes.
+//
+int 
+numa_init(numa_topology * t) 
+{
+
+  cpu_set_t allowed;
+  char      path[256], list[4096];
+  int       node, c;
+
+  memset(t, 0, sizeof(numa_topology));
+
+  CPU_ZERO(&allowed);
+  if ( sched_getaffinity(0, sizeof(allowed), &allowed) != 0 ) {
+    for (c = 0; c < CPU_SETSIZE; c++) {
+      CPU_SET(c, &allowed);
+    }
+  }
+
+  for (node = 0; node < 4 * NUMA_MAX_NODES && t->nnodes < NUMA_MAX_NODES; node++) {
+
+    FILE * fp;
+
+    snprintf(path, sizeof(path), "%s/node%d/cpulist", NUMA_SYSFS_NODES, node);
+    if ( (fp = fopen(path, "r")) == NULL ) {
+      continue;
+    }
+    if ( fgets(list, sizeof(list), fp) == NULL ) {
+      list[0] = '\0';
+    }
+    fclose(fp);
+
+    int * cpus = malloc( CPU_SETSIZE * sizeof(int) );
+    if ( ! cpus ) {
+      fprintf(stderr, "Out of memory! Could not allocate the CPU list of a node\n");
+      exit(1);
+    }
+
+    int n = parse_cpu_list(list, &allowed, cpus, CPU_SETSIZE);
+    if ( n == 0 ) {
+      // A memory-only node, or no allowed CPU on it
+      free(cpus);
+      continue;
+    }
+
+    t->node_id[t->nnodes] = node;
+    t->ncpus[t->nnodes]   = n;
+    t->cpus[t->nnodes]    = cpus;
+    t->nnodes++;
+  }
+
+  if ( t->nnodes == 0 ) {
+    int * cpus = malloc( CPU_SETSIZE * sizeof(int) );
+    int   n = 0;
+    if ( ! cpus ) {
+      fprintf(stderr, "Out of memory! Could not allocate the CPU list\n");
+      exit(1);
+    }
+    for (c = 0; c < CPU_SETSIZE; c++) {
+      if ( CPU_ISSET(c, &allowed) ) {
+	cpus[n++] = c;
+      }
+    }
+    t->node_id[0] = -1;   // no node to bind memory to
+    t->ncpus[0]   = n;
+    t->cpus[0]    = cpus;
+    t->nnodes     = 1;
+  }
+
+  return t->nnodes;
+
+} // numa_init()
+
+
+
+//
+// Pin the calling thread, number tid of nthreads, to a CPU. 
+// The threads are spread over the nodes in contiguous blocks, 
+// so that threads tid and tid+1 share a node when possible. 
+// Return the (0-based) index of the node.
+//
+int 
+numa_pin_thread(numa_topology * t, int tid, int nthreads) 
+{
+
+  cpu_set_t mask;
+  int node, first, cpu;
+
+  node  = (int) ( (long) tid * t->nnodes / nthreads );
+  first = (int) ( ( (long) node * nthreads + t->nnodes - 1 ) / t->nnodes );
+  cpu   = t->cpus[node][ (tid - first) % t->ncpus[node] ];
+
+  CPU_ZERO(&mask);
+  CPU_SET(cpu, &mask);
+
+  if ( sched_setaffinity(0, sizeof(mask), &mask) != 0 ) {
+    fprintf(stderr, "[warn] Could not pin thread %d to CPU %d\n", tid, cpu);
+  }
+
+  thread_node = node;
+
+  fprintf2_(stderr, "Thread %d pinned to CPU %d on node %d\n", tid, cpu, t->node_id[node]);
+
+  return node;
+
+} // numa_pin_thread()
+
+
+
+int 
+numa_thread_node(void) 
+{
+  return thread_node;
+}
+
+
+
+//
+// Bind the pages of [p, p+len) to the node with index node; 
+// p must be page aligned
+//
+void 
+numa_bind_memory(void * p, size_t len, int node) 
+{
+
+  unsigned long mask[NUMA_MAX_NODES * 4 / (8 * sizeof(unsigned long)) + 1];
+  int id = numa_topo.node_id[node];
+
+  if ( id < 0 ) {
+    return;
+  }
+
+  memset(mask, 0, sizeof(mask));
+  mask[id / (8 * sizeof(unsigned long))] |= 1UL << (id % (8 * sizeof(unsigned long)));
+
+  if ( syscall(SYS_mbind, p, len, MPOL_BIND, mask, 8 * sizeof(mask), 0) != 0 ) {
+    fprintf2_(stderr, "mbind to node %d failed\n", id);
+  }
+
+} // numa_bind_memory()
+
+
+
+void 
+numa_router_init(numa_router * r, int nthreads) 
+{
+
+  memset(r, 0, sizeof(numa_router));
+
+  r->nthreads    = nthreads;
+  r->thread_node = calloc( nthreads, sizeof(int) );
+  if ( ! r->thread_node ) {
+    fprintf(stderr, "Out of memory! Could not allocate the thread nodes\n");
+    exit(1);
+  }
+
+  omp_init_lock( &(r->lock) );
+
+} // numa_router_init()
+
+
+
+void 
+numa_router_free(numa_router * r) 
+{
+
+  omp_destroy_lock( &(r->lock) );
+  free(r->thread_node);
+
+} // numa_router_free()
+
+
+
+//
+// Node that holds chunk number chunk_num: the chunks are 
+// dealt to the threads in turn, so each node gets a share 
+// of the chunks proportional to its number of threads
+//
+int 
+numa_chunk_node(numa_router * r, uint32_t chunk_num) 
+{
+
+  return r->thread_node[ chunk_num % r->nthreads ];
+
+} // numa_chunk_node()
+
+
+
+void 
+numa_router_put(numa_router * r, sff_read_chunk * chunk) 
+{
+
+  int node = chunk->node;
+
+  omp_set_lock( &(r->lock) );
+
+  chunk->next_free = NULL;
+  if ( r->tail[node] == NULL ) {
+    r->head[node] = chunk;
+  }
+  else {
+    r->tail[node]->next_free = chunk;
+  }
+  r->tail[node] = chunk;
+
+  if ( node != thread_node ) {
+    r->bytes_remote_fill += arena_bytes( &(chunk->arena) );
+  }
+
+  omp_unset_lock( &(r->lock) );
+
+} // numa_router_put()
+
+
+
+//
+// Take the oldest chunk of the node of the calling thread, 
+// or of the first node that has one. A chunk is queued 
+// before the task that takes a chunk is created, so there 
+// is always a chunk to take.
+//
+sff_read_chunk * 
+numa_router_take(numa_router * r) 
+{
+
+  sff_read_chunk * chunk = NULL;
+  int k, node = thread_node;
+
+  omp_set_lock( &(r->lock) );
+
+  for (k = 0; k < numa_topo.nnodes && chunk == NULL; k++) {
+
+    int n = (node + k) % numa_topo.nnodes;
+
+    if ( r->head[n] != NULL ) {
+      chunk = r->head[n];
+      r->head[n] = chunk->next_free;
+      if ( r->head[n] == NULL ) {
+	r->tail[n] = NULL;
+      }
+      chunk->next_free = NULL;
+    }
+  }
+
+  if ( chunk != NULL ) {
+    if ( chunk->node == node ) {
+      r->nchunks_local++;
+    }
+    else {
+      r->nchunks_remote++;
+      r->bytes_remote += arena_bytes( &(chunk->arena) );
+    }
+  }
+
+  omp_unset_lock( &(r->lock) );
+
+  return chunk;
+
+} // numa_router_take()
+
+
+
+void 
+numa_router_report(numa_router * r) 
+{
+
+  uint64_t total = r->nchunks_local + r->nchunks_remote;
+
+  printf("NUMA: %d node(s), %d thread(s); %llu of %llu chunks classified on their node, "
+	 "%llu on another node (%.1f MB); reader filled %.1f MB of arenas on other nodes\n", 
+	 numa_topo.nnodes, r->nthreads, 
+	 (unsigned long long) r->nchunks_local, (unsigned long long) total, 
+	 (unsigned long long) r->nchunks_remote, r->bytes_remote / 1e6, 
+	 r->bytes_remote_fill / 1e6);
+
+} // numa_router_report()
@@ -0,0 +1,402 @@
+/*
+
+  Hardware performance counters for the stages of the
+  split pipeline (read, classify, write, compress), per
+  thread, using perf_event_open(2).
+
+  Each thread opens its own counters the first time it
+  enters a stage, counting only that thread (the hardware
+  events in user mode).
+  The counters are read when a stage is entered and left,
+  and the difference is charged to the stage. When a stage
+  is entered inside another one (e.g., a compression task
+  run by a thread that writes a split), the time spent in
+  the inner stage is charged only to the inner stage.
+
+  The events that cannot be opened (no PMU in a virtual
+  machine, perf_event_paranoid too high, ...) are reported
+  as n/a, and the run proceeds.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+#include "reorder.h"
+
+
+
+/** GLOBALS **/
+
+// Set by the --perf option
+int perf_enabled = 0;
+
+static int          perf_nthreads = 0;
+static perf_thread * perf_threads = NULL;
+
+// The counts, [thread][stage][event or PERF_TIME], followed by
+// the number of threads that could open each event
+static uint64_t   * perf_count    = NULL;
+static int          perf_ncount   = 0;
+
+static const struct {
+  uint32_t     type;
+  uint64_t     config;
+  const char * name;
+} perf_events[PERF_NEVENTS] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,       "cycles"        },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,     "instructions"  },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,     "LLC misses"    },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,    "branch misses" },
+  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "ctx switches"  }
+};
+
+static const char * perf_stage_name[PERF_NSTAGES] = {
+  "read", "classify", "write", "compress"
+};
+
+
+
+/** FUNCTIONS **/
+
+
+#define PERF_COUNT(t, s, e)  perf_count[ ( (t) * PERF_NSTAGES + (s) ) * (PERF_NEVENTS + 1) + (e) ]
+#define PERF_OPENED(e)       perf_count[ perf_nthreads * PERF_NSTAGES * (PERF_NEVENTS + 1) + (e) ]
+
+
+
+//
+// Allocate the counts of nthreads threads
+//
+void
+perf_init(int nthreads)
+{
+
+  int t, e;
+
+  perf_nthreads = nthreads;
+  perf_ncount   = nthreads * PERF_NSTAGES * (PERF_NEVENTS + 1) + PERF_NEVENTS;
+
+  perf_threads = calloc( nthreads, sizeof(perf_thread) );
+  perf_count   = calloc( perf_ncount, sizeof(uint64_t) );
+  if ( ! perf_threads || ! perf_count ) {
+    fprintf(stderr, "Out of memory! Could not allocate the performance counts\n");
+    exit(1);
+  }
+
+  for (t = 0; t < nthreads; t++) {
+    for (e = 0; e < PERF_NEVENTS; e++) {
+      perf_threads[t].fd[e] = -1;
+    }
+  }
+
+} // perf_init()
+
+
+
+//
+// Open the counters of the calling thread
+//
+static void
+perf_open(perf_thread * pt)
+{
+
+  struct perf_event_attr attr;
+  int e, nopened = 0, err = 0;
+
+  for (e = 0; e < PERF_NEVENTS; e++) {
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = perf_events[e].type;
+    attr.config         = perf_events[e].config;
+    // Count the hardware events in user mode; a context 
+    // switch is a kernel event
+    if ( attr.type == PERF_TYPE_HARDWARE ) {
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+    }
+
+    // pid 0, cpu -1: the calling thread, on any CPU
+    pt->fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if ( pt->fd[e] < 0 ) {
+      err = errno;
+      continue;
+    }
+
+    nopened++;
+#pragma omp atomic
+    PERF_OPENED(e)++;
+  }
+
+  pt->opened = 1;
+
+  if ( nopened < PERF_NEVENTS ) {
+    fprintf2_(stderr, "Opened %d of %d counters: %s\n", nopened, PERF_NEVENTS, strerror(err));
+  }
+
+} // perf_open()
+
+
+
+//
+// Read the counters and the time of the calling thread
+//
+static void
+perf_read(perf_thread * pt, uint64_t * now)
+{
+
+  struct timespec ts;
+  int e;
+
+  for (e = 0; e < PERF_NEVENTS; e++) {
+    now[e] = 0;
+    if ( pt->fd[e] >= 0 && read(pt->fd[e], &now[e], sizeof(uint64_t)) != sizeof(uint64_t) ) {
+      now[e] = 0;
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  now[PERF_TIME] = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+} // perf_read()
+
+
+
+//
+// Charge the counts since pt->start to the stage on top of the
+// stack of the thread, and restart counting from now
+//
+static void
+perf_charge(perf_thread * pt, int tid, uint64_t * now)
+{
+
+  int e;
+
+  if ( pt->depth > 0 ) {
+    int stage = pt->stack[pt->depth - 1];
+    for (e = 0; e <= PERF_NEVENTS; e++) {
+      PERF_COUNT(tid, stage, e) += now[e] - pt->start[e];
+    }
+  }
+
+  memcpy(pt->start, now, sizeof(pt->start));
+
+} // perf_charge()
+
+
+
+//
+// The calling thread enters a stage
+//
+void
+perf_begin(int stage)
+{
+
+  uint64_t now[PERF_NEVENTS + 1];
+  int tid;
+
+  if ( ! perf_enabled ) {
+    return;
+  }
+
+  tid = omp_get_thread_num();
+  if ( tid >= perf_nthreads ) {
+    return;
+  }
+
+  perf_thread * pt = &perf_threads[tid];
+
+  if ( ! pt->opened ) {
+    perf_open(pt);
+  }
+
+  // Too deeply nested: charge to the enclosing stage
+  if ( pt->depth >= PERF_MAX_DEPTH ) {
+    pt->depth++;
+    return;
+  }
+
+  perf_read(pt, now);
+  perf_charge(pt, tid, now);
+
+  pt->stack[pt->depth] = stage;
+  pt->depth++;
+
+} // perf_begin()
+
+
+
+//
+// The calling thread leaves the stage it entered last
+//
+void
+perf_end(void)
+{
+
+  uint64_t now[PERF_NEVENTS + 1];
+  int tid;
+
+  if ( ! perf_enabled ) {
+    return;
+  }
+
+  tid = omp_get_thread_num();
+  if ( tid >= perf_nthreads ) {
+    return;
+  }
+
+  perf_thread * pt = &perf_threads[tid];
+
+  if ( pt->depth > PERF_MAX_DEPTH ) {
+    pt->depth--;
+    return;
+  }
+
+  perf_read(pt, now);
+  perf_charge(pt, tid, now);
+  pt->depth--;
+
+} // perf_end()
+
+
+
+//
+// The counts, e.g., to sum them over the MPI ranks
+//
+uint64_t *
+perf_counts(int * n)
+{
+
+  *n = perf_ncount;
+
+  return perf_count;
+
+} // perf_counts()
+
+
+
+//
+// Print a count, or n/a if no thread could open the event
+//
+static void
+print_count(int e, uint64_t count)
+{
+
+  if ( PERF_OPENED(e) == 0 ) {
+    printf("  %14s", "n/a");
+  }
+  else {
+    printf("  %14llu", (unsigned long long) count);
+  }
+
+} // print_count()
+
+
+
+static void
+print_row(const char * stage, const char * thread, uint64_t * c)
+{
+
+  int e;
+
+  printf("  %-9s %6s  %10.3f", stage, thread, c[PERF_TIME] / 1e9);
+  for (e = 0; e < PERF_NEVENTS; e++) {
+    print_count(e, c[e]);
+  }
+
+  if ( PERF_OPENED(PERF_CYCLES) && PERF_OPENED(PERF_INSTRUCTIONS) && c[PERF_CYCLES] > 0 ) {
+    printf("  %5.2f\n", (double) c[PERF_INSTRUCTIONS] / c[PERF_CYCLES]);
+  }
+  else {
+    printf("  %5s\n", "n/a");
+  }
+
+} // print_row()
+
+
+
+//
+// Print the counts per stage and thread, and the total
+// of each stage over the threads
+//
+void
+perf_report(void)
+{
+
+  uint64_t total[PERF_NEVENTS + 1];
+  char     thread[16];
+  int      s, t, e;
+
+  printf("Performance counters per stage and thread:\n");
+  printf("  %-9s %6s  %10s", "stage", "thread", "time (s)");
+  for (e = 0; e < PERF_NEVENTS; e++) {
+    printf("  %14s", perf_events[e].name);
+  }
+  printf("  %5s\n", "IPC");
+
+  for (s = 0; s < PERF_NSTAGES; s++) {
+
+    memset(total, 0, sizeof(total));
+
+    for (t = 0; t < perf_nthreads; t++) {
+      if ( PERF_COUNT(t, s, PERF_TIME) == 0 ) {
+	continue;
+      }
+      snprintf(thread, sizeof(thread), "%d", t);
+      print_row(perf_stage_name[s], thread, &PERF_COUNT(t, s, 0));
+
+      for (e = 0; e <= PERF_NEVENTS; e++) {
+	total[e] += PERF_COUNT(t, s, e);
+      }
+    }
+
+    if ( total[PERF_TIME] > 0 ) {
+      print_row(perf_stage_name[s], "all", total);
+    }
+  }
+
+  for (e = 0; e < PERF_NEVENTS; e++) {
+    if ( PERF_OPENED(e) == 0 ) {
+      printf("  n/a: the event could not be opened (no PMU, or see /proc/sys/kernel/perf_event_paranoid)\n");
+      break;
+    }
+  }
+
+} // perf_report()
+
+
+
+void
+perf_free(void)
+{
+
+  int t, e;
+
+  for (t = 0; t < perf_nthreads; t++) {
+    for (e = 0; e < PERF_NEVENTS; e++) {
+      if ( perf_threads[t].fd[e] >= 0 ) {
+	close(perf_threads[t].fd[e]);
+      }
+    }
+  }
+
+  free(perf_threads);
+  free(perf_count);
+  perf_threads  = NULL;
+  perf_count    = NULL;
+  perf_nthreads = 0;
+
+} // perf_free()
@@ -0,0 +1,269 @@
+/*
+
+  Reorder stage for the reads classified in parallel: 
+  the chunks of reads are emitted to the splits in the 
+  order of the read numbers, independent of the number 
+  of threads and of their timing.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "reorder.h"
+
+
+
+// Chunks freed by free_read_chunk(), for reuse, by NUMA node
+static sff_read_chunk * chunk_pool[MAX_CHUNK_NODES] = { NULL };
+
+
+
+//
+// Get a chunk that can hold nreads reads, from the pool of 
+// the NUMA node if possible, with an empty arena
+//
+sff_read_chunk * alloc_read_chunk(uint32_t first_read, uint32_t nreads, int node) 
+{
+
+  sff_read_chunk * chunk;
+
+  #pragma omp critical (chunk_pool)
+  {
+    chunk = chunk_pool[node];
+    if ( chunk != NULL ) {
+      chunk_pool[node] = chunk->next_free;
+    }
+  }
+
+  if ( chunk == NULL ) {
+    chunk = calloc( 1, sizeof(sff_read_chunk) );
+    if ( ! chunk ) {
+      fprintf(stderr, "Out of memory! Could not allocate a chunk of reads\n");
+      exit(1);
+    }
+    arena_init( &(chunk->arena) );
+    chunk->node = node;
+  }
+
+  if ( chunk->capacity < nreads ) {
+    free(chunk->reads);
+    chunk->reads = malloc( nreads * sizeof(sff_split_read) );
+    if ( ! chunk->reads ) {
+      fprintf(stderr, "Out of memory! Could not allocate a chunk of %u reads\n", nreads);
+      exit(1);
+    }
+    chunk->capacity = nreads;
+  }
+
+  memset( chunk->reads, 0, nreads * sizeof(sff_split_read) );
+  arena_reset( &(chunk->arena) );
+
+  chunk->first_read = first_read;
+  chunk->nreads     = nreads;
+  chunk->next_free  = NULL;
+
+  return chunk;
+
+} // alloc_read_chunk()
+
+
+
+//
+// Return a chunk to the pool. The reads are released 
+// with the arena; only a flowgram decoded on request 
+// was allocated separately.
+//
+void free_read_chunk(sff_read_chunk * chunk) 
+{
+
+  uint32_t k;
+
+  for (k = 0; k < chunk->nreads; k++) {
+    free( chunk->reads[k].rd.flowgram );
+  }
+
+  #pragma omp critical (chunk_pool)
+  {
+    chunk->next_free = chunk_pool[chunk->node];
+    chunk_pool[chunk->node] = chunk;
+  }
+
+} // free_read_chunk()
+
+
+
+//
+// Free the chunks in the pool, at the end of the split
+//
+void free_chunk_pool(void) 
+{
+
+  sff_read_chunk * chunk;
+  int node;
+
+  for (node = 0; node < MAX_CHUNK_NODES; node++) {
+    while ( (chunk = chunk_pool[node]) != NULL ) {
+      chunk_pool[node] = chunk->next_free;
+      arena_free( &(chunk->arena) );
+      free(chunk->reads);
+      free(chunk);
+    }
+  }
+
+} // free_chunk_pool()
+
+
+
+//
+// Record that the read sr of the chunk goes to the split 
+// pat_idx. The hits are kept in the arena of the chunk.
+//
+void add_read_hit(sff_read_chunk * chunk, sff_split_read * sr, int pat_idx, sff_read_header * rh_trim) 
+{
+
+  if ( sr->nhits == sr->hit_cap ) {
+    sff_read_hit * hits;
+    sr->hit_cap = sr->hit_cap ? 2 * sr->hit_cap : 2;
+    hits = arena_alloc( &(chunk->arena), sr->hit_cap * sizeof(sff_read_hit) );
+    if ( sr->nhits > 0 ) {
+      memcpy( hits, sr->hits, sr->nhits * sizeof(sff_read_hit) );
+    }
+    sr->hits = hits;
+  }
+
+  sr->hits[sr->nhits].pat_idx = pat_idx;
+  sr->hits[sr->nhits].rh_trim = *rh_trim;
+  sr->nhits++;
+
+} // add_read_hit()
+
+
+
+void reorder_init(reorder_buffer * rb, uint32_t nslots, uint32_t chunk_size) 
+{
+
+  rb->nslots     = nslots;
+  rb->chunk_size = chunk_size;
+  rb->next_read  = 0;
+
+  rb->slots = calloc( nslots, sizeof(sff_read_chunk *) );
+  if ( ! rb->slots ) {
+    fprintf(stderr, "Out of memory! Could not allocate %u reorder slots\n", nslots);
+    exit(1);
+  }
+
+  omp_init_lock( &(rb->lock) );
+
+} // reorder_init()
+
+
+
+void reorder_free(reorder_buffer * rb) 
+{
+
+  omp_destroy_lock( &(rb->lock) );
+  free(rb->slots);
+  rb->slots = NULL;
+
+} // reorder_free()
+
+
+
+//
+// Return non-zero if the chunk starting at first_read 
+// falls within the window of the reorder buffer
+//
+int reorder_has_room(reorder_buffer * rb, uint32_t first_read) 
+{
+
+  uint32_t next_read;
+
+  #pragma omp atomic read
+  next_read = rb->next_read;
+
+  return (first_read - next_read) / rb->chunk_size < rb->nslots;
+
+} // reorder_has_room()
+
+
+
+//
+// Deposit a classified chunk in its slot
+//
+void reorder_put(reorder_buffer * rb, sff_read_chunk * chunk) 
+{
+
+  uint32_t slot = (chunk->first_read / rb->chunk_size) % rb->nslots;
+
+  #pragma omp flush
+
+  #pragma omp atomic write
+  rb->slots[slot] = chunk;
+
+  #pragma omp flush
+
+} // reorder_put()
+
+
+
+//
+// Emit, in order, the chunks that are ready. Only one thread 
+// emits at a time; the other threads return immediately and 
+// leave their chunks to the emitting thread.
+//
+void reorder_drain(reorder_buffer * rb, emit_chunk_fn emit) 
+{
+
+  sff_read_chunk * chunk;
+  uint32_t slot, next_read;
+
+  while ( omp_test_lock( &(rb->lock) ) ) {
+
+    for (;;) {
+
+      slot = (rb->next_read / rb->chunk_size) % rb->nslots;
+
+      #pragma omp flush
+      #pragma omp atomic read
+      chunk = rb->slots[slot];
+
+      if ( chunk == NULL || chunk->first_read != rb->next_read ) {
+	break;
+      }
+
+      rb->slots[slot] = NULL;
+      emit(chunk);
+
+      #pragma omp atomic write
+      rb->next_read = rb->next_read + chunk->nreads;
+
+      free_read_chunk(chunk);
+    }
+
+    omp_unset_lock( &(rb->lock) );
+
+    //
+    // A chunk may have been deposited after the check above 
+    // but before the lock was released; if so, emit it now
+    //
+    #pragma omp atomic read
+    next_read = rb->next_read;
+
+    slot = (next_read / rb->chunk_size) % rb->nslots;
+
+    #pragma omp flush
+    #pragma omp atomic read
+    chunk = rb->slots[slot];
+
+    if ( chunk == NULL ) {
+      break;
+    }
+  }
+
+} // reorder_drain()
@@ -17,10 +17,158 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define SFF_X86_SIMD
+#endif
+
 #include "sff.h"
 
 
 
+/*
+ * The fixed-size fields of a read header are read, written 
+ * and byte-swapped as one block of SFF_READ_HEADER_FIXED bytes, 
+ * which relies on the struct members having the file layout
+ */
+typedef char sff_read_header_layout_check[
+    ( offsetof(sff_read_header, clip_adapter_right) == SFF_READ_HEADER_FIXED - 2 ) ? 1 : -1 ];
+
+
+
+/** BYTE SWAPPING **/
+
+static void 
+swap16_scalar(uint16_t *dst, const uint16_t *src, size_t n) 
+{
+    size_t i;
+    for (i = 0; i < n; i++) {
+        dst[i] = htobe16( src[i] );
+    }
+}
+
+
+#ifdef SFF_X86_SIMD
+
+__attribute__((target("ssse3"))) 
+static void 
+swap16_ssse3(uint16_t *dst, const uint16_t *src, size_t n) 
+{
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128( (const __m128i *) (src + i) );
+        _mm_storeu_si128( (__m128i *) (dst + i), _mm_shuffle_epi8(v, mask) );
+    }
+
+    swap16_scalar(dst + i, src + i, n - i);
+}
+
+
+__attribute__((target("avx2"))) 
+static void 
+swap16_avx2(uint16_t *dst, const uint16_t *src, size_t n) 
+{
+    // pshufb shuffles within each 128-bit lane
+    const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+
+    for ( ; i + 32 <= n; i += 32) {
+        __m256i v0 = _mm256_loadu_si256( (const __m256i *) (src + i) );
+        __m256i v1 = _mm256_loadu_si256( (const __m256i *) (src + i + 16) );
+        _mm256_storeu_si256( (__m256i *) (dst + i),      _mm256_shuffle_epi8(v0, mask) );
+        _mm256_storeu_si256( (__m256i *) (dst + i + 16), _mm256_shuffle_epi8(v1, mask) );
+    }
+
+    for ( ; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256( (const __m256i *) (src + i) );
+        _mm256_storeu_si256( (__m256i *) (dst + i), _mm256_shuffle_epi8(v, mask) );
+    }
+
+    swap16_scalar(dst + i, src + i, n - i);
+}
+
+
+//
+// The fixed fields of a read header: two 16-bit fields, 
+// one 32-bit field and four 16-bit fields
+//
+__attribute__((target("ssse3"))) 
+static void 
+swap_read_header_ssse3(sff_read_header *rh) 
+{
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 7, 6, 5, 4, 9, 8, 11, 10, 13, 12, 15, 14);
+    __m128i v = _mm_loadu_si128( (const __m128i *) rh );
+    _mm_storeu_si128( (__m128i *) rh, _mm_shuffle_epi8(v, mask) );
+}
+
+#endif // SFF_X86_SIMD
+
+
+static void (*swap16_kernel)(uint16_t *, const uint16_t *, size_t) = swap16_scalar;
+static void (*swap_read_header_kernel)(sff_read_header *) = NULL;
+static const char * swap_kernel_name = "scalar";
+
+
+//
+// Select the byte-swap kernels for the CPU at startup. The 
+// environment variable SFF_BYTESWAP (scalar, ssse3 or avx2) 
+// can force a kernel that the CPU supports, e.g., to compare them.
+//
+__attribute__((constructor)) 
+static void 
+select_byteswap_kernels(void) 
+{
+#ifdef SFF_X86_SIMD
+    const char * force = getenv("SFF_BYTESWAP");
+    int use_avx2, use_ssse3;
+
+    __builtin_cpu_init();
+    use_ssse3 = __builtin_cpu_supports("ssse3");
+    use_avx2  = __builtin_cpu_supports("avx2");
+
+    if ( force != NULL ) {
+        use_avx2  = use_avx2  && strcmp(force, "avx2") == 0;
+        use_ssse3 = use_ssse3 && strcmp(force, "scalar") != 0;
+    }
+
+    if ( use_ssse3 ) {
+        swap_read_header_kernel = swap_read_header_ssse3;
+        swap16_kernel    = swap16_ssse3;
+        swap_kernel_name = "ssse3";
+    }
+    if ( use_avx2 ) {
+        swap16_kernel    = swap16_avx2;
+        swap_kernel_name = "avx2";
+    }
+#endif
+}
+
+
+//
+// Convert n 16-bit values between big endian and host order; 
+// dst may be the same as src
+//
+void 
+convert_big_endian_16(uint16_t *dst, const uint16_t *src, size_t n) 
+{
+    swap16_kernel(dst, src, n);
+}
+
+
+const char * 
+byteswap_kernel_name(void) 
+{
+    return swap_kernel_name;
+}
+
+
+
 /** FUNCTIONS **/
 
 void 
@@ -362,39 +510,13 @@ read_sff_read_header(FILE *fp, sff_read_header *rh) {
     int header_size;
     size_t actual;
 
-    actual = fread(&(rh->header_len)        , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not read the header length", 1);
-    }
-
-    actual = fread(&(rh->name_len)          , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not read the name length", 1);
-    }
-
-    actual = fread(&(rh->nbases)            , sizeof(uint32_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not read the number of bases", 1);
-    }
-
-    actual = fread(&(rh->clip_qual_left)    , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not read clip_qual_left", 1);
-    }
-
-    actual = fread(&(rh->clip_qual_right)   , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not read clip_qual_right", 1);
-    }
-
-    actual = fread(&(rh->clip_adapter_left) , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not read clip_adapter_left", 1);
-    }
-
-    actual = fread(&(rh->clip_adapter_right), sizeof(uint16_t), 1, fp);
+    //
+    // The fixed-size fields: header_len, name_len, nbases, 
+    // and the four clip values
+    //
+    actual = fread(rh, SFF_READ_HEADER_FIXED, 1, fp);
     if ( actual != 1 ) {
-        bailout(fp, "Could not read clip_adapter_right", 1);
+        bailout(fp, "Could not read the fixed fields of the read header", 1);
     }
 
 
@@ -473,39 +595,9 @@ write_sff_read_header(FILE *fp, sff_read_header *rh) {
     //
     // 3. Write the read-header
     //
-    actual = fwrite(&(rhl.header_len)        , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not write the header_len", 1);
-    }
-
-    actual = fwrite(&(rhl.name_len)          , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not write the name_len", 1);
-    }
-
-    actual = fwrite(&(rhl.nbases)            , sizeof(uint32_t), 1, fp);
+    actual = fwrite(&rhl, SFF_READ_HEADER_FIXED, 1, fp);
     if ( actual != 1 ) {
-        bailout(fp, "Could not write the number of bases ", 1);
-    }
-
-    actual = fwrite(&(rhl.clip_qual_left)    , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not write clip_qual_left", 1);
-    }
-
-    actual = fwrite(&(rhl.clip_qual_right)   , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not write clip_qual_right", 1);
-    }
-
-    actual = fwrite(&(rhl.clip_adapter_left) , sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not write clip_adapter_left", 1);
-    }
-
-    fwrite(&(rhl.clip_adapter_right), sizeof(uint16_t), 1, fp);
-    if ( actual != 1 ) {
-        bailout(fp, "Could not write clip_adapter_right", 1);
+        bailout(fp, "Could not write the fixed fields of the read header", 1);
     }
 
     actual = fwrite(rhl.name                 , sizeof(char), rh->name_len, fp);
@@ -537,6 +629,11 @@ write_sff_read_header(FILE *fp, sff_read_header *rh) {
 void 
 convert_big_endian_read_header_2_host(sff_read_header *rh) 
 {
+    if ( swap_read_header_kernel != NULL ) {
+        swap_read_header_kernel(rh);
+        return;
+    }
+
     rh->header_len         = htobe16(rh->header_len);
     rh->name_len           = htobe16(rh->name_len);
     rh->nbases             = htobe32(rh->nbases);
@@ -568,7 +665,6 @@ read_sff_read_data(FILE *fp,
 {
 
     int data_size;
-    register int i;
     size_t actual;
 
 
@@ -576,6 +672,8 @@ read_sff_read_data(FILE *fp,
     // 1. Allocate the flowgram, flow-index, bases, and quality arrays 
     //
 
+    rd->raw = NULL;
+
     rd->flowgram = (uint16_t *) malloc( nflows * sizeof(uint16_t) );
     if ( ! rd->flowgram ) {
         bailout(fp, "Out of memory! Could not allocate for a read flowgram", 1);
@@ -611,13 +709,7 @@ read_sff_read_data(FILE *fp,
     }
 
     /* sff files are in big endian notation so adjust appropriately */
-    for (i = 0; i < nflows; i++) {
-        rd->flowgram[i] = htobe16( rd->flowgram[i] );
-	//if ( i < 16 ) {
-	//  fprintf(stderr, "\tR_%-10d flow=%8d be_flow=%8d\n", 
-	//	  read_num, rd->flowgram[i], htobe16(rd->flowgram[i]));
-	//}
-    }
+    convert_big_endian_16(rd->flowgram, rd->flowgram, nflows);
 
 
     //
@@ -675,6 +767,140 @@ read_sff_read_data(FILE *fp,
 
 
 
+//
+// Read the data section of a read with a single fread, 
+// without decoding it: flow_index, bases and quality point 
+// into the raw section, and the flowgram is left NULL until 
+// get_read_flowgram() is called. Classifying a read then 
+// touches only the bases it looks at, and writing it copies 
+// the raw section.
+//
+void
+read_sff_read_data_lazy(FILE *fp, 
+                   sff_read_data *rd, 
+                   uint16_t nflows, 
+                   uint32_t nbases, 
+		   uint32_t read_num
+		   ) 
+{
+
+    size_t data_size, padded_size, actual;
+
+    data_size = (sizeof(uint16_t) * nflows)    // flowgram size
+                + (sizeof(uint8_t) * nbases)   // flow_index size
+                + (sizeof(char) * nbases)      // bases size
+                + (sizeof(uint8_t) * nbases);  // quality size
+
+    padded_size = (data_size + PADDING_SIZE - 1) / PADDING_SIZE * PADDING_SIZE;
+
+    rd->raw = (uint8_t *) malloc( padded_size );
+    if ( ! rd->raw ) {
+        bailout(fp, "Out of memory! Could not allocate for the data of a read", 1);
+    }
+
+    actual = fread(rd->raw, sizeof(uint8_t), padded_size, fp);
+    if ( actual != padded_size ) {
+        bailout(fp, "Could not read the data section of a read", 1);
+    }
+
+    // The padding is written as zeros, as by write_padding()
+    memset(rd->raw + data_size, 0, padded_size - data_size);
+
+    rd->flowgram   = NULL;
+    rd->flow_index = rd->raw + sizeof(uint16_t) * nflows;
+    rd->bases      = (char *) (rd->flow_index + nbases);
+    rd->quality    = (uint8_t *) (rd->bases + nbases);
+
+    fprintf_s(stderr, "\nRead data section of read %u lazily (%d bytes)\n\n", 
+	      read_num, (int) padded_size);
+
+} // read_sff_read_data_lazy()
+
+
+
+
+//
+// Read a whole read record (header and data) into the arena: 
+// the fixed fields go to rh, and the name and the data section 
+// are read with one fread into a single arena allocation. The 
+// data section is laid out as by read_sff_read_data_lazy().
+//
+void
+read_sff_read_record(FILE *fp, 
+                   sff_read_header *rh, 
+                   sff_read_data *rd, 
+                   uint16_t nflows, 
+                   sff_arena *arena) 
+{
+
+    size_t  header_size, data_size, padded_size, actual;
+    char  * buf;
+
+    actual = fread(rh, SFF_READ_HEADER_FIXED, 1, fp);
+    if ( actual != 1 ) {
+        bailout(fp, "Could not read the fixed fields of the read header", 1);
+    }
+    convert_big_endian_read_header_2_host(rh);
+
+    header_size = SFF_READ_HEADER_FIXED + rh->name_len;
+    header_size = (header_size + PADDING_SIZE - 1) / PADDING_SIZE * PADDING_SIZE;
+
+    data_size   = (sizeof(uint16_t) * nflows) + 3 * (size_t) rh->nbases;
+    padded_size = (data_size + PADDING_SIZE - 1) / PADDING_SIZE * PADDING_SIZE;
+
+    buf = arena_alloc(arena, header_size - SFF_READ_HEADER_FIXED + padded_size);
+
+    actual = fread(buf, 1, header_size - SFF_READ_HEADER_FIXED + padded_size, fp);
+    if ( actual != header_size - SFF_READ_HEADER_FIXED + padded_size ) {
+        bailout(fp, "Could not read the name and data section of a read", 1);
+    }
+
+    rh->name = buf;
+
+    rd->raw = (uint8_t *) buf + header_size - SFF_READ_HEADER_FIXED;
+
+    // The padding is written as zeros, as by write_padding()
+    memset(rd->raw + data_size, 0, padded_size - data_size);
+
+    rd->flowgram   = NULL;
+    rd->flow_index = rd->raw + sizeof(uint16_t) * nflows;
+    rd->bases      = (char *) (rd->flow_index + rh->nbases);
+    rd->quality    = (uint8_t *) (rd->bases + rh->nbases);
+
+} // read_sff_read_record()
+
+
+
+
+//
+// Return the flowgram of the read, decoding it 
+// from the raw section on the first request
+//
+uint16_t * 
+get_read_flowgram(sff_read_data *rd, 
+                  uint16_t nflows) 
+{
+
+
+    if ( rd->flowgram == NULL && rd->raw != NULL ) {
+
+        rd->flowgram = (uint16_t *) malloc( nflows * sizeof(uint16_t) );
+        if ( ! rd->flowgram ) {
+            fprintf(stderr, "Out of memory! Could not allocate for a read flowgram\n");
+            exit(1);
+        }
+
+        convert_big_endian_16(rd->flowgram, (uint16_t *) rd->raw, nflows);
+    }
+
+    return rd->flowgram;
+
+} // get_read_flowgram()
+
+
+
+
+
 void
 write_sff_read_data(FILE *fp, 
                    sff_read_data *rd, 
@@ -685,13 +911,30 @@ write_sff_read_data(FILE *fp,
 {
 
     int data_size;
-    register int i;
     size_t actual;
 
     //
     // Write data section from rd sff_read_data struct into sff file 
     //
 
+    //
+    // 0. A section read lazily is written as it was read, 
+    //    padding included, without decoding it
+    //
+    if ( rd->raw != NULL ) {
+
+        data_size = (sizeof(uint16_t) * nflows) + 3 * nbases;
+        data_size = (data_size + PADDING_SIZE - 1) / PADDING_SIZE * PADDING_SIZE;
+
+        actual = fwrite(rd->raw, sizeof(uint8_t), (size_t) data_size, fp);
+        if ( actual != (size_t) data_size ) {
+            bailout(fp, "Could not write the data section of a read", 1);
+        }
+
+        fflush(fp);
+        return;
+    }
+
     //
     // 1. Write the array of flowgram values (one flowgram per flow)
     //
@@ -702,15 +945,7 @@ write_sff_read_data(FILE *fp,
     }
 
     // sff files are in big endian notation so adjust appropriately 
-    for (i = 0; i < nflows; i++) {
-
-        flowgram[i] = htobe16( rd->flowgram[i] );
-
-	//if ( i < 16) {
-	//  fprintf(stderr, "\tW_%-10d flow=%8d be_flow=%8d\n", 
-	//	  read_num, rd->flowgram[i], flowgram[i]);
-	//}
-    }
+    convert_big_endian_16(flowgram, rd->flowgram, nflows);
 
     actual = fwrite(flowgram, sizeof(uint16_t), (size_t) nflows, fp);
     if ( actual != nflows ) {
@@ -777,6 +1012,11 @@ write_sff_read_data(FILE *fp,
 void
 free_sff_read_data(sff_read_data *d) {
     free(d->flowgram);
+    if ( d->raw != NULL ) {
+        // flow_index, bases and quality point into raw
+        free(d->raw);
+        return;
+    }
     free(d->flow_index);
     free(d->bases);
     free(d->quality);
@@ -884,6 +1124,263 @@ get_read_quality_values(sff_read_data rd,
 
 
 
+//
+// Size in bytes of the (padded) data section of a read
+//
+off_t 
+sff_read_data_size(sff_common_header * ch, uint32_t nbases) 
+{
+
+    off_t size = (off_t) ch->flow_len * sizeof(uint16_t) + (off_t) nbases * 3;
+
+    return (size + PADDING_SIZE - 1) / PADDING_SIZE * PADDING_SIZE;
+
+} // sff_read_data_size()
+
+
+
+//
+// The reads occupy the bytes [data_start, data_end) of the 
+// file, from the end of the common header, where fp is, to 
+// the index section if any, else to the end of the file. An 
+// index_offset past the end of the file or before the reads 
+// is stale (the file kept the header of another, as older 
+// split files did) and is ignored. fp is left at data_start.
+//
+void sff_data_range(FILE              * fp, 
+                    sff_common_header * ch, 
+                    off_t             * data_start, 
+                    off_t             * data_end) 
+{
+
+    off_t size;
+
+    *data_start = ftello(fp);
+    fseeko(fp, 0, SEEK_END);
+    size = ftello(fp);
+
+    *data_end = size;
+    if ( ch->index_offset > 0 && 
+         (off_t) ch->index_offset >= *data_start && 
+         (off_t) ch->index_offset <= size ) {
+        *data_end = (off_t) ch->index_offset;
+    }
+
+    fseeko(fp, *data_start, SEEK_SET);
+
+} // sff_data_range()
+
+
+
+//
+// Check whether a read record starts at offset. If so, 
+// set next to the offset of the following record and 
+// return 1; otherwise return 0.
+//
+int probe_read_record(FILE              * fp, 
+                      sff_common_header * ch, 
+                      off_t               offset, 
+                      off_t               data_end, 
+                      off_t             * next) 
+{
+
+    sff_read_header rh;
+    char            name[256];
+    int             i;
+
+    if ( offset + 16 > data_end || fseeko(fp, offset, SEEK_SET) != 0 ) {
+        return 0;
+    }
+
+    if ( fread(&rh, SFF_READ_HEADER_FIXED, 1, fp) != 1 ) {
+        return 0;
+    }
+
+    convert_big_endian_read_header_2_host(&rh);
+
+
+    //
+    // The fields of a read header are tightly constrained; a 
+    // random byte offset almost never passes all the checks
+    //
+    if ( rh.name_len == 0 || rh.name_len > sizeof(name) ) {
+        return 0;
+    }
+    if ( rh.header_len != (16 + rh.name_len + PADDING_SIZE - 1) / PADDING_SIZE * PADDING_SIZE ) {
+        return 0;
+    }
+    if ( rh.nbases == 0 || rh.nbases > SFF_MAX_BASES ) {
+        return 0;
+    }
+    if ( rh.clip_qual_left    > rh.nbases + 1 || rh.clip_qual_right    > rh.nbases || 
+         rh.clip_adapter_left > rh.nbases + 1 || rh.clip_adapter_right > rh.nbases ) {
+        return 0;
+    }
+
+    if ( fread(name, sizeof(char), rh.name_len, fp) != rh.name_len ) {
+        return 0;
+    }
+    for (i = 0; i < rh.name_len; i++) {
+        if ( ! isgraph( (unsigned char) name[i] ) ) {
+            return 0;
+        }
+    }
+
+    *next = offset + rh.header_len + sff_read_data_size(ch, rh.nbases);
+
+    return *next <= data_end;
+
+} // probe_read_record()
+
+
+
+//
+// Find the first record boundary at or after start: an offset 
+// followed by SFF_SYNC_RECORDS valid records (or by valid 
+// records up to the end of the data section)
+//
+int resync_read_record(FILE              * fp, 
+                       sff_common_header * ch, 
+                       off_t               start, 
+                       off_t               data_end, 
+                       off_t             * rec_offset) 
+{
+
+    off_t off, cur, next;
+    int   k;
+
+    for (off = start; off < data_end; off += PADDING_SIZE) {
+
+        cur = off;
+        for (k = 0; k < SFF_SYNC_RECORDS; k++) {
+            if ( ! probe_read_record(fp, ch, cur, data_end, &next) ) {
+                break;
+            }
+            cur = next;
+            if ( cur == data_end ) {
+                k = SFF_SYNC_RECORDS;
+                break;
+            }
+        }
+
+        if ( k == SFF_SYNC_RECORDS ) {
+            *rec_offset = off;
+            return 1;
+        }
+    }
+
+    return 0;
+
+} // resync_read_record()
+
+
+
+//
+// Build the index of the offsets of all the reads by 
+// scanning the read headers and skipping the data sections
+//
+void build_read_index(FILE              * fp, 
+                      sff_common_header * ch, 
+                      off_t               data_start, 
+                      off_t               data_end, 
+                      off_t            ** offsets) 
+{
+
+    uint32_t  i;
+    off_t     off, next;
+
+    *offsets = malloc( (size_t) ch->nreads * sizeof(off_t) );
+    if ( ! *offsets ) {
+        bailout(fp, "Out of memory! Could not allocate the read index", 1);
+    }
+
+    off = data_start;
+    for (i = 0; i < ch->nreads; i++) {
+        if ( ! probe_read_record(fp, ch, off, data_end, &next) ) {
+            fprintf(stderr, "[err] Invalid read record %u at offset %lld\n", i, (long long) off);
+            bailout(fp, "Could not build the read index", 1);
+        }
+        (*offsets)[i] = off;
+        off = next;
+    }
+
+} // build_read_index()
+
+
+
+//
+// Load a read index saved by save_read_index(). Return 0 if 
+// the index file is missing or does not match the SFF file 
+// described by ch and data_end.
+//
+int load_read_index(char              * idx_file, 
+                    sff_common_header * ch, 
+                    off_t               data_end, 
+                    off_t            ** offsets) 
+{
+
+    FILE    * idx_fp;
+    uint64_t  hdr[3];
+
+    if ( (idx_fp = fopen(idx_file, "r")) == NULL ) {
+        return 0;
+    }
+
+    *offsets = malloc( (size_t) ch->nreads * sizeof(off_t) );
+    if ( ! *offsets ) {
+        bailout(idx_fp, "Out of memory! Could not allocate the read index", 1);
+    }
+
+    if ( fread(hdr, sizeof(uint64_t), 3, idx_fp) == 3 && 
+         hdr[0] == SFF_MAGIC && hdr[1] == ch->nreads && hdr[2] == (uint64_t) data_end && 
+         fread(*offsets, sizeof(off_t), ch->nreads, idx_fp) == ch->nreads ) {
+        fclose(idx_fp);
+        return 1;
+    }
+
+    fprintf(stderr, "[warn] Ignoring stale read index '%s'\n", idx_file);
+    fclose(idx_fp);
+    free(*offsets);
+    *offsets = NULL;
+
+    return 0;
+
+} // load_read_index()
+
+
+
+//
+// Save the read index: a header { SFF_MAGIC, nreads, data_end } 
+// of 64-bit words followed by the offsets of the reads. 
+// Return 0 on failure.
+//
+int save_read_index(char              * idx_file, 
+                    sff_common_header * ch, 
+                    off_t               data_end, 
+                    off_t             * offsets) 
+{
+
+    FILE    * idx_fp;
+    uint64_t  hdr[3];
+    int       ok;
+
+    if ( (idx_fp = fopen(idx_file, "w")) == NULL ) {
+        return 0;
+    }
+
+    hdr[0] = SFF_MAGIC;
+    hdr[1] = ch->nreads;
+    hdr[2] = (uint64_t) data_end;
+
+    ok = fwrite(hdr, sizeof(uint64_t), 3, idx_fp) == 3 && 
+         fwrite(offsets, sizeof(off_t), ch->nreads, idx_fp) == ch->nreads;
+
+    return (fclose(idx_fp) == 0) && ok;
+
+} // save_read_index()
+
+
+
 void 
 bailout(FILE *fp, char * msg, int err) {
 
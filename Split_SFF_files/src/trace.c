@@ -0,0 +1,228 @@
+/*
+
+  Timeline of the stages of the split pipeline, exported
+  in the Chrome trace-event format (JSON), which can be
+  loaded in Perfetto or chrome://tracing.
+
+  Each thread records the begin and end events of the
+  stages it runs in a ring of its own, so recording takes
+  no lock. At the end of the run, the begin and end events
+  of each thread are paired, and each pair is written as a
+  complete ("X") event.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+#include "reorder.h"
+
+
+
+/** GLOBALS **/
+
+// Set by trace_init()
+int trace_enabled = 0;
+
+static int          trace_nthreads = 0;
+static trace_ring * trace_rings    = NULL;
+static uint64_t     trace_mask     = 0;      // capacity of a ring - 1
+static uint64_t     trace_t0       = 0;
+
+static const char * trace_stage_name[TRACE_NSTAGES] = {
+  "read", "classify", "write", "flush", "compress", "wait"
+};
+
+static const char * trace_arg_name[TRACE_NSTAGES] = {
+  "first_read", "first_read", "first_read", "split", "block", "first_read"
+};
+
+
+
+/** FUNCTIONS **/
+
+
+static uint64_t
+trace_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+
+//
+// Allocate a ring of at least nevents events for each of
+// nthreads threads, and start the clock
+//
+void
+trace_init(int nthreads, uint32_t nevents)
+{
+
+  uint64_t capacity = 1;
+  int t;
+
+  while ( capacity < nevents ) {
+    capacity <<= 1;
+  }
+
+  trace_nthreads = nthreads;
+  trace_mask     = capacity - 1;
+
+  if ( posix_memalign( (void **) &trace_rings, 64, nthreads * sizeof(trace_ring) ) != 0 ) {
+    fprintf(stderr, "Out of memory! Could not allocate the trace rings\n");
+    exit(1);
+  }
+
+  for (t = 0; t < nthreads; t++) {
+    trace_rings[t].head   = 0;
+    trace_rings[t].events = malloc( capacity * sizeof(trace_event) );
+    if ( ! trace_rings[t].events ) {
+      fprintf(stderr, "Out of memory! Could not allocate the trace events\n");
+      exit(1);
+    }
+  }
+
+  trace_t0      = trace_now();
+  trace_enabled = 1;
+
+} // trace_init()
+
+
+
+//
+// Record an event in the ring of the calling thread
+//
+void
+trace_record(int stage, int phase, int64_t arg)
+{
+
+  int tid = omp_get_thread_num();
+
+  if ( tid >= trace_nthreads ) {
+    return;
+  }
+
+  trace_ring  * r = &trace_rings[tid];
+  trace_event * e = &(r->events[ r->head & trace_mask ]);
+
+  e->ts    = trace_now() - trace_t0;
+  e->arg   = arg;
+  e->stage = stage;
+  e->phase = phase;
+
+  r->head++;
+
+} // trace_record()
+
+
+
+//
+// Write the events of the threads to file as a Chrome trace;
+// pid identifies the process (the MPI rank) in the trace
+//
+void
+trace_dump(char * file, int pid)
+{
+
+  FILE     * fp;
+  uint64_t   ndropped = 0;
+  int        t;
+
+  if ( (fp = fopen(file, "w")) == NULL ) {
+    fprintf(stderr, "[err] Could not open file '%s' for writing the trace.\n", file);
+    return;
+  }
+
+  fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,"
+	  "\"args\":{\"name\":\"split_sff %d\"}}", pid, pid);
+
+  for (t = 0; t < trace_nthreads; t++) {
+
+    trace_ring * r = &trace_rings[t];
+    trace_event * stack[TRACE_MAX_DEPTH];
+    uint64_t i, start;
+    int depth = 0;
+
+    if ( r->head == 0 ) {
+      continue;
+    }
+
+    fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+	    "\"args\":{\"name\":\"thread %d\"}}", pid, t, t);
+
+    //
+    // Pair the begin and end events that are still in the ring;
+    // an end event whose begin event was overwritten is skipped
+    //
+    start = ( r->head > trace_mask + 1 ) ? r->head - (trace_mask + 1) : 0;
+    ndropped += start;
+
+    for (i = start; i < r->head; i++) {
+
+      trace_event * e = &(r->events[ i & trace_mask ]);
+
+      if ( e->phase == 'B' ) {
+	if ( depth < TRACE_MAX_DEPTH ) {
+	  stack[depth] = e;
+	}
+	depth++;
+	continue;
+      }
+
+      if ( depth == 0 ) {
+	continue;
+      }
+      depth--;
+      if ( depth >= TRACE_MAX_DEPTH ) {
+	continue;
+      }
+
+      trace_event * b = stack[depth];
+
+      fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"split\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+	      "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"%s\":%lld}}",
+	      trace_stage_name[b->stage], pid, t,
+	      b->ts / 1e3, (e->ts - b->ts) / 1e3,
+	      trace_arg_name[b->stage], (long long) b->arg);
+    }
+  }
+
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+
+  if ( ndropped > 0 ) {
+    fprintf(stderr, "[warn] The trace rings overflowed: the oldest %llu events were dropped\n",
+	    (unsigned long long) ndropped);
+  }
+
+} // trace_dump()
+
+
+
+void
+trace_free(void)
+{
+
+  int t;
+
+  trace_enabled = 0;
+
+  for (t = 0; t < trace_nthreads; t++) {
+    free(trace_rings[t].events);
+  }
+  free(trace_rings);
+  trace_rings    = NULL;
+  trace_nthreads = 0;
+
+} // trace_free()
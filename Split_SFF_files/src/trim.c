@@ -0,0 +1,158 @@
+/*
+
+  Functions to trim the reads of an SFF file 
+  while they are being split, so that no 
+  separate trimming pass is needed.
+
+  Author
+
+     Gabriel Mateescu  mateescu@acm.org
+*/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "trim.h"
+
+
+
+//
+// Return non-zero if any trimming policy is active
+//
+int trim_enabled(sff_trim_options * opt) 
+{
+
+  if ( opt == NULL ) {
+    return 0;
+  }
+
+  return opt->qual_threshold > 0 || opt->remove_barcode || opt->min_length > 0;
+
+} // trim_enabled()
+
+
+
+
+//
+// Slide a window over quality[left:right-1] and return the 
+// index at which the first window whose mean quality is 
+// below threshold starts, i.e., the new (0-based, exclusive) 
+// right clip. Return right if no window falls below threshold.
+//
+int trim_quality_window(uint8_t * quality, 
+                        int       left, 
+                        int       right, 
+                        int       window, 
+                        int       threshold) 
+{
+
+  int i, sum = 0;
+  int min_sum;
+
+  if ( window <= 0 ) {
+    window = TRIM_DEFAULT_WINDOW;
+  }
+
+  // Reads shorter than a window are judged by a single window
+  if ( right - left < window ) {
+    window = right - left;
+  }
+  if ( window <= 0 ) {
+    return right;
+  }
+
+  // Compare sums rather than means to avoid a division per window
+  min_sum = threshold * window;
+
+  for (i = left; i < left + window; i++) {
+    sum += quality[i];
+  }
+
+  for (i = left; ; i++) {
+
+    if ( sum < min_sum ) {
+      fprintf2_(stderr, "Quality window [%d:%d] sum=%d < %d\n", i, i+window-1, sum, min_sum);
+      return i;
+    }
+
+    if ( i + window >= right ) {
+      break;
+    }
+
+    // Slide the window by one base
+    sum += quality[i + window] - quality[i];
+  }
+
+  return right;
+
+} // trim_quality_window()
+
+
+
+
+//
+// Apply the trimming policies to the read header rh, writing 
+// the result to rh_trim. The barcode_end argument is the 
+// 0-based index of the first base after the matched barcode.
+//
+// Return the number of bases left between the updated 
+// clip points.
+//
+int trim_read_header(sff_read_header  * rh_trim, 
+                     sff_read_header  * rh, 
+                     sff_read_data    * rd, 
+                     sff_trim_options * opt, 
+                     int                barcode_end) 
+{
+
+  int left, right;
+
+  *rh_trim = *rh;
+
+
+  //
+  // 1. Barcode removal: the clip_qual_left field is 1-based, 
+  //    so the first base after the barcode is barcode_end + 1
+  //
+  if ( opt->remove_barcode ) {
+    if ( rh_trim->clip_qual_left < barcode_end + 1 ) {
+      rh_trim->clip_qual_left = (uint16_t) (barcode_end + 1);
+    }
+  }
+
+
+  //
+  // 2. Sliding-window quality trimming of the 3' end, 
+  //    within the current clip points
+  //
+  get_clip_values(*rh_trim, 1, &left, &right);
+
+  if ( opt->qual_threshold > 0 && right > left ) {
+
+    right = trim_quality_window(rd->quality, left, right, 
+                                opt->qual_window, opt->qual_threshold);
+
+    rh_trim->clip_qual_right = (uint16_t) right;
+  }
+
+  get_clip_values(*rh_trim, 1, &left, &right);
+
+
+  //
+  // 3. No bases left: clip_qual_right is 1-based and 0 would 
+  //    mean "no clip", so mark the range empty by putting the 
+  //    left clip point after the right one
+  //
+  if ( right <= left ) {
+    rh_trim->clip_qual_right = (uint16_t) max(left, 1);
+    rh_trim->clip_qual_left  = rh_trim->clip_qual_right + 1;
+    return 0;
+  }
+
+  return right - left;
+
+  return max(right - left, 0);
+
+} // trim_read_header()